@@ -46,6 +46,9 @@
 #include "directory.hh"
 #include "file_header.hh"
 #include "lib/bitmap.hh"
+#ifdef SWAP_ON_DISK
+#include "vmem/swap_area.hh"
+#endif
 
 #include <stdio.h>
 #include <string.h>
@@ -81,6 +84,12 @@ FileSystem::FileSystem(bool format)
         // (make sure no one else grabs these!)
         freeMap->Mark(FREE_MAP_SECTOR);
         freeMap->Mark(DIRECTORY_SECTOR);
+#ifdef SWAP_ON_DISK
+        // The end of the disk is left for the swap area.
+        for (unsigned i = FIRST_SWAP_SECTOR; i < NUM_SECTORS; i++) {
+            freeMap->Mark(i);
+        }
+#endif
 
         // Second, allocate space for the data blocks containing the contents
         // of the directory and bitmap files.  There better be enough space!
@@ -413,6 +422,11 @@ FileSystem::Check()
     Bitmap *shadowMap = new Bitmap(NUM_SECTORS);
     shadowMap->Mark(FREE_MAP_SECTOR);
     shadowMap->Mark(DIRECTORY_SECTOR);
+#ifdef SWAP_ON_DISK
+    for (unsigned i = FIRST_SWAP_SECTOR; i < NUM_SECTORS; i++) {
+        shadowMap->Mark(i);
+    }
+#endif
 
     DEBUG('f', "Checking bitmap's file header.\n");
 
@@ -26,6 +26,7 @@ OpenFile::OpenFile(int sector)
 {
     hdr = new FileHeader;
     hdr->FetchFrom(sector);
+    headerSector = sector;
     seekPosition = 0;
 }
 
@@ -196,3 +197,9 @@ OpenFile::Length() const
 {
     return hdr->FileLength();
 }
+
+unsigned long long
+OpenFile::GetId() const
+{
+    return headerSector;
+}
@@ -79,6 +79,11 @@ public:
         return SystemDep::Tell(file);
     }
 
+    unsigned long long GetId() const
+    {
+        return SystemDep::FileId(file);
+    }
+
 private:
     int file;
     unsigned currentOffset;
@@ -114,8 +119,14 @@ public:
     // the UNIX idiom -- `lseek` to end of file, `tell`, `lseek` back).
     unsigned Length() const;
 
+    /// Return a number that tells this file apart from any other that
+    /// exists at the same time, whatever name it was opened by: the sector
+    /// of its header.
+    unsigned long long GetId() const;
+
   private:
     FileHeader *hdr;  ///< Header for this file.
+    int headerSector;  ///< Where `hdr` is on disk.
     unsigned seekPosition;  ///< Current position within the file.
 };
 
@@ -85,3 +85,9 @@ SynchDisk::RequestDone()
 {
     semaphore->V();
 }
+
+Disk *
+SynchDisk::GetDisk()
+{
+    return disk;
+}
@@ -44,6 +44,9 @@ public:
     /// current disk operation is complete.
     void RequestDone();
 
+    /// Return the raw disk device, for snapshots of the whole machine.
+    Disk *GetDisk();
+
 private:
     Disk *disk;  ///< Raw disk device.
     Semaphore *semaphore;  ///< To synchronize requesting thread with the
@@ -18,11 +18,6 @@
 #include <string.h>
 
 
-Debug::Debug()
-{
-    flags = "";
-}
-
 bool
 Debug::IsEnabled(char flag) const
 {
@@ -37,7 +37,9 @@ public:
 
     /// No flag is set at the beginning, so no debug message would be
     /// printed until `SetFlags` is called.
-    Debug();
+    constexpr Debug()
+      : flags(""), opts()
+    {}
 
     /// Is this debug flag enabled?
     bool IsEnabled(char flag) const;
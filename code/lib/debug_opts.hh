@@ -26,13 +26,9 @@ struct DebugOpts {
     /// Whether to wait for user input right after each debug message.
     bool interactive;
 
-    DebugOpts()
-    {
-        location = false;
-        function = false;
-        sleep = false;
-        interactive = false;
-    }
+    constexpr DebugOpts()
+      : location(false), function(false), sleep(false), interactive(false)
+    {}
 };
 
 
@@ -78,6 +78,10 @@ public:
     /// Remove first item from list.
     Item SortedPop(int *keyPtr);
 
+    /// Do `SortedPop` followed by `SortedInsert` of the same item, `n`
+    /// times.
+    void SortedRotate(unsigned long n);
+
 private:
 
     typedef ListElement<Item> ListNode;
@@ -192,6 +196,31 @@ List<Item>::Pop()
     return SortedPop(nullptr);
 }
 
+/// Take the first item off the list and insert it back in order, `n` times.
+///
+/// Since `SortedInsert` places an item behind every other item with the
+/// same key, this cycles through the items that share the smallest key,
+/// while the rest of the list is left untouched.
+template <class Item>
+void
+List<Item>::SortedRotate(unsigned long n)
+{
+    if (IsEmpty()) {
+        return;
+    }
+
+    unsigned long tied = 1;
+    for (ListNode *ptr = first->next;
+         ptr != nullptr && ptr->key == first->key; ptr = ptr->next) {
+        tied++;
+    }
+    for (n %= tied; n > 0; n--) {
+        int key;
+        Item item = SortedPop(&key);
+        SortedInsert(item, key);
+    }
+}
+
 template <class Item>
 void
 List<Item>::Remove(Item item)
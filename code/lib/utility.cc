@@ -6,4 +6,4 @@
 #include "utility.hh"
 
 
-Debug debug;
+thread_local Debug debug;
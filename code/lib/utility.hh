@@ -64,7 +64,10 @@ typedef void (*VoidNoArgFunctionPtr)();
 
 
 /// Global object for debug output.
-extern Debug debug;
+///
+/// Like the rest of the kernel state, there is one per host thread, see
+/// `KernelInstance`.
+extern thread_local Debug debug;
 
 #define DEBUG(...)  (debug.Print)(__FILE__, __LINE__, __func__, __VA_ARGS__)
 #define DEBUG_CONT  (debug.PrintCont)
@@ -0,0 +1,150 @@
+/// Routines to cache decoded user instructions.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "decode_cache.hh"
+#include "endianness.hh"
+#include "lib/utility.hh"
+
+
+/// * `memory` is the simulated physical memory.
+/// * `nFrames` is the number of frames in `memory`.
+/// * `size` is the size of each frame in bytes; it must be a multiple of
+///   the word size.
+DecodeCache::DecodeCache(const char *memory, unsigned nFrames, unsigned size)
+{
+    ASSERT(memory != nullptr);
+    ASSERT(size % 4 == 0);
+
+    mainMemory    = memory;
+    frameSize     = size;
+    wordsPerFrame = size / 4;
+    numFrames     = nFrames;
+
+    frames   = new FrameCode * [numFrames];
+    versions = new unsigned long [numFrames];
+    for (unsigned i = 0; i < numFrames; i++) {
+        frames[i]   = nullptr;
+        versions[i] = 0;
+    }
+}
+
+DecodeCache::~DecodeCache()
+{
+    for (unsigned i = 0; i < numFrames; i++) {
+        if (frames[i] != nullptr) {
+            delete [] frames[i]->instr;
+            delete [] frames[i]->valid;
+            delete frames[i];
+        }
+    }
+    delete [] frames;
+    delete [] versions;
+}
+
+const Instruction *
+DecodeCache::Lookup(unsigned physAddr)
+{
+    ASSERT(physAddr % 4 == 0);
+
+    unsigned frame = physAddr / frameSize;
+    unsigned word  = physAddr % frameSize / 4;
+    ASSERT(frame < numFrames);
+
+    FrameCode *code = frames[frame];
+    if (code == nullptr || !code->valid[word]) {
+        DecodeBlock(frame, word);
+        code = frames[frame];
+    }
+    return &code->instr[word];
+}
+
+unsigned
+DecodeCache::BlockLength(unsigned physAddr)
+{
+    unsigned length = 0;
+    bool delaySlot = false;
+    do {
+        const Instruction *instr = Lookup(physAddr + length * 4);
+        length++;
+        if (delaySlot || AlwaysTraps(instr->opCode)) {
+            break;
+        }
+        delaySlot = HasDelaySlot(instr->opCode);
+    } while ((physAddr / 4 + length) % wordsPerFrame != 0);
+    return length;
+}
+
+unsigned long
+DecodeCache::FrameVersion(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+    return versions[frame];
+}
+
+void
+DecodeCache::DecodeBlock(unsigned frame, unsigned word)
+{
+    FrameCode *code = frames[frame];
+    if (code == nullptr) {
+        code = new FrameCode;
+        code->instr    = new Instruction [wordsPerFrame];
+        code->valid    = new bool [wordsPerFrame];
+        code->numValid = 0;
+        for (unsigned i = 0; i < wordsPerFrame; i++) {
+            code->valid[i] = false;
+        }
+        frames[frame] = code;
+    }
+
+    const unsigned *words = (const unsigned *) &mainMemory[frame * frameSize];
+    bool delaySlot = false;
+    for (unsigned i = word; i < wordsPerFrame && !code->valid[i]; i++) {
+        Instruction *instr = &code->instr[i];
+        instr->value = WordToHost(words[i]);
+        instr->Decode();
+        code->valid[i] = true;
+        code->numValid++;
+
+        if (delaySlot || AlwaysTraps(instr->opCode)) {
+            break;
+        }
+        delaySlot = HasDelaySlot(instr->opCode);
+    }
+}
+
+void
+DecodeCache::NoteWrite(unsigned physAddr)
+{
+    unsigned frame = physAddr / frameSize;
+    ASSERT(frame < numFrames);
+
+    FrameCode *code = frames[frame];
+    if (code != nullptr) {
+        unsigned word = physAddr % frameSize / 4;
+        if (code->valid[word]) {
+            code->valid[word] = false;
+            code->numValid--;
+            versions[frame]++;
+        }
+    }
+}
+
+void
+DecodeCache::InvalidateFrame(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    FrameCode *code = frames[frame];
+    if (code == nullptr || code->numValid == 0) {
+        return;
+    }
+    for (unsigned i = 0; i < wordsPerFrame; i++) {
+        code->valid[i] = false;
+    }
+    code->numValid = 0;
+    versions[frame]++;
+}
@@ -0,0 +1,130 @@
+/// Data structures for caching decoded user instructions.
+///
+/// Decoding a MIPS instruction is cheap, but it is done for every single
+/// instruction the simulator executes, even when the same handful of loops
+/// run over and over.  This cache keeps the result of `Instruction::Decode`
+/// for every word of physical memory that has been fetched as code, so that
+/// the simulator only decodes an instruction again after its memory
+/// changes.
+///
+/// Entries are indexed by physical frame and by word within the frame.
+/// Each frame belongs to a single address space at a time, so as long as
+/// the kernel invalidates a frame whenever it hands it over to another
+/// virtual page (see `CoreMap`), the cache behaves as a per address space
+/// one, without having to be flushed on context switches.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_DECODECACHE__HH
+#define NACHOS_MACHINE_DECODECACHE__HH
+
+
+#include "instruction.hh"
+
+
+/// Return true if `opCode` transfers control after a delay slot.
+static inline bool
+HasDelaySlot(unsigned char opCode)
+{
+    switch (opCode) {
+        case OP_BEQ:
+        case OP_BGEZ:
+        case OP_BGEZAL:
+        case OP_BGTZ:
+        case OP_BLEZ:
+        case OP_BLTZ:
+        case OP_BLTZAL:
+        case OP_BNE:
+        case OP_J:
+        case OP_JAL:
+        case OP_JALR:
+        case OP_JR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Return true if `opCode` always traps to the kernel.
+static inline bool
+AlwaysTraps(unsigned char opCode)
+{
+    return opCode == OP_SYSCALL || opCode == OP_RES || opCode == OP_UNIMP;
+}
+
+class DecodeCache {
+public:
+
+    /// Initialize an empty cache for a memory of `numFrames` frames of
+    /// `frameSize` bytes each, whose contents are in `memory`.
+    DecodeCache(const char *memory, unsigned numFrames, unsigned frameSize);
+
+    /// De-allocate the cache.
+    ~DecodeCache();
+
+    /// Return the decoded instruction stored at `physAddr`.
+    ///
+    /// On a miss, the whole basic block starting at `physAddr` is decoded:
+    /// every instruction up to the next branch or jump (plus its delay
+    /// slot), a trap, or the end of the frame.
+    ///
+    /// The returned pointer remains valid until the cache is destroyed,
+    /// although the instruction it points to may be re-decoded once the
+    /// underlying memory changes.
+    const Instruction *Lookup(unsigned physAddr);
+
+    /// Return the number of instructions in the basic block that starts at
+    /// `physAddr`, decoding them if needed.
+    unsigned BlockLength(unsigned physAddr);
+
+    /// Return a counter that changes every time some instruction decoded
+    /// from `frame` is invalidated.
+    ///
+    /// Anything derived from the decoded contents of a frame (such as
+    /// translated code) is up to date as long as this value does not
+    /// change.
+    unsigned long FrameVersion(unsigned frame) const;
+
+    /// Tell the cache that the word at `physAddr` was modified by a user
+    /// store.
+    void NoteWrite(unsigned physAddr);
+
+    /// Forget every instruction decoded from `frame`.
+    ///
+    /// Must be called whenever the contents of the frame are replaced
+    /// without going through the MMU, for instance when a page is loaded,
+    /// evicted or read back from swap.
+    void InvalidateFrame(unsigned frame);
+
+private:
+
+    /// Translated code checks whether a frame holds decoded instructions
+    /// by itself.
+    friend class Jit;
+
+    /// Decoded contents of one physical frame.
+    struct FrameCode {
+        Instruction *instr;  ///< One decoded instruction per word.
+        bool *valid;         ///< Whether the corresponding word is decoded.
+        unsigned numValid;   ///< Number of words currently decoded.
+    };
+
+    /// Decode the basic block that starts at word `word` of `frame`.
+    void DecodeBlock(unsigned frame, unsigned word);
+
+    const char *mainMemory;
+    unsigned frameSize;
+    unsigned wordsPerFrame;
+    unsigned numFrames;
+
+    /// Allocated lazily, the first time code is fetched from each frame.
+    FrameCode **frames;
+
+    /// One counter per frame, see `FrameVersion`.
+    unsigned long *versions;
+};
+
+
+#endif
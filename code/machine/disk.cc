@@ -160,6 +160,47 @@ Disk::WriteRequest(unsigned sectorNumber, const char *data)
     interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
 }
 
+void
+Disk::ReadSectorNow(unsigned sectorNumber, char *data)
+{
+    ASSERT(data != nullptr);
+    ASSERT(!active);
+    ASSERT(sectorNumber < NUM_SECTORS);
+
+    SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+    SystemDep::Read(fileno, data, SECTOR_SIZE);
+}
+
+void
+Disk::WriteSectorNow(unsigned sectorNumber, const char *data)
+{
+    ASSERT(data != nullptr);
+    ASSERT(!active);
+    ASSERT(sectorNumber < NUM_SECTORS);
+
+    SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+    SystemDep::WriteFile(fileno, data, SECTOR_SIZE);
+}
+
+void
+Disk::GetHeadState(unsigned *sector, int *buffer) const
+{
+    ASSERT(sector != nullptr);
+    ASSERT(buffer != nullptr);
+
+    *sector = lastSector;
+    *buffer = bufferInit;
+}
+
+void
+Disk::SetHeadState(unsigned sector, int buffer)
+{
+    ASSERT(sector < NUM_SECTORS);
+
+    lastSector = sector;
+    bufferInit = buffer;
+}
+
 /// Called when it is time to invoke the disk interrupt handler, to tell the
 /// Nachos kernel that the disk request is done.
 void
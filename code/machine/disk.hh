@@ -82,6 +82,21 @@ public:
     ///     (seek + rotational delay + transfer)
     int ComputeLatency(unsigned newSector, bool writing);
 
+    /// Read/write a single disk sector right away, without taking any
+    /// simulated time nor raising an interrupt.
+    ///
+    /// Only meant for saving and restoring snapshots of the whole machine;
+    /// no request may be in progress.
+
+    void ReadSectorNow(unsigned sectorNumber, char *data);
+    void WriteSectorNow(unsigned sectorNumber, const char *data);
+
+    /// Get/set the position of the head and of the track buffer, which
+    /// determine the latency of the next request.
+
+    void GetHeadState(unsigned *sector, int *buffer) const;
+    void SetHeadState(unsigned sector, int buffer);
+
 private:
     int fileno;  ///< UNIX file number for simulated disk.
     VoidFunctionPtr handler;  ///< Interrupt handler, to be invoked when any
@@ -158,6 +158,29 @@ Interrupt::OneTick()
     }
     DEBUG('i', "== Tick %u ==\n", stats->totalTicks);
 
+    FireDue(old);
+}
+
+/// Account for `n` ticks of kernel work at once, for instance a long
+/// operation done natively on behalf of a user program, and then fire the
+/// interrupts that became due, as `OneTick` does.
+void
+Interrupt::AdvanceSystemTicks(unsigned long n)
+{
+    ASSERT(status == SYSTEM_MODE);
+
+    stats->totalTicks += n;
+    stats->systemTicks += n;
+    DEBUG('i', "== Tick %u ==\n", stats->totalTicks);
+
+    FireDue(status);
+}
+
+/// Fire every pending interrupt that is due, and do the context switch the
+/// timer may have asked for.  `old` is the status to return to afterwards.
+void
+Interrupt::FireDue(MachineStatus old)
+{
     // Check any pending interrupts are now ready to fire.
     ChangeLevel(INT_ON, INT_OFF);  // First, turn off interrupts (interrupt
                                    // handlers run with interrupts disabled).
@@ -172,6 +195,51 @@ Interrupt::OneTick()
     }
 }
 
+/// Return how many user instructions can be executed before `OneTick` would
+/// fire an interrupt.
+///
+/// Only the head of the pending list matters, because that is the only
+/// entry `CheckIfDue` looks at.
+unsigned long
+Interrupt::UserTicksBeforeDue() const
+{
+    ASSERT(status == USER_MODE);
+
+    if (yieldOnReturn) {
+        return 0;
+    }
+    if (pending->IsEmpty()) {
+        return ULONG_MAX;
+    }
+
+    unsigned long when = pending->Head()->when;
+    if (when <= stats->totalTicks) {
+        return 0;
+    }
+    return (when - stats->totalTicks - 1) / USER_TICK;
+}
+
+/// Advance simulated time by `n` user ticks without checking for interrupts
+/// one tick at a time.
+///
+/// Every `OneTick` that finds the head of the pending list not yet due pops
+/// it and inserts it back behind any other interrupt scheduled for the same
+/// time.  The same rotation is applied here, so that interrupts that become
+/// due together still fire in the same order.
+///
+/// * `n` is the number of user instructions executed; it must not be
+///   greater than `UserTicksBeforeDue()`.
+void
+Interrupt::AdvanceUserTicks(unsigned long n)
+{
+    ASSERT(n <= UserTicksBeforeDue());
+
+    stats->totalTicks += n * USER_TICK;
+    stats->userTicks  += n * USER_TICK;
+
+    pending->SortedRotate(n);
+}
+
 /// Called from within an interrupt handler, to cause a context switch (for
 /// example, on a time slice) in the interrupted thread, when the handler
 /// returns.
@@ -255,6 +323,85 @@ Interrupt::RestartTicks()
 }
 #endif
 
+unsigned
+Interrupt::GetPending(IntType *types, unsigned long *whens, unsigned max)
+{
+    ASSERT(max == 0 || (types != nullptr && whens != nullptr));
+
+    List<PendingInterrupt *> *oldPending = pending;
+    pending = new List<PendingInterrupt *>;
+
+    PendingInterrupt *i;
+    int               when;
+    unsigned          n = 0;
+    while ((i = oldPending->SortedPop(&when)) != nullptr) {
+        if (n < max) {
+            types[n] = i->type;
+            whens[n] = i->when;
+        }
+        n++;
+        pending->SortedInsert(i, when);
+    }
+
+    delete oldPending;
+    return n;
+}
+
+bool
+Interrupt::SetPending(const IntType *types, const unsigned long *whens,
+                      unsigned n)
+{
+    ASSERT(types != nullptr);
+    ASSERT(whens != nullptr);
+
+    // Collect the pending interrupts, leaving the list as it was.
+    List<PendingInterrupt *> *oldPending = pending;
+    pending = new List<PendingInterrupt *>;
+
+    PendingInterrupt **current = new PendingInterrupt * [n];
+    PendingInterrupt *i;
+    int               when;
+    unsigned          numCurrent = 0;
+    while ((i = oldPending->SortedPop(&when)) != nullptr) {
+        if (numCurrent < n) {
+            current[numCurrent] = i;
+        }
+        numCurrent++;
+        pending->SortedInsert(i, when);
+    }
+    delete oldPending;
+
+    // Match them by kind.
+    PendingInterrupt **matched = new PendingInterrupt * [n];
+    bool ok = numCurrent == n;
+    for (unsigned k = 0; ok && k < n; k++) {
+        matched[k] = nullptr;
+        for (unsigned j = 0; j < n; j++) {
+            if (current[j] != nullptr && current[j]->type == types[k]) {
+                matched[k] = current[j];
+                current[j] = nullptr;
+                break;
+            }
+        }
+        ok = matched[k] != nullptr;
+    }
+
+    if (ok) {
+        delete pending;
+        pending = new List<PendingInterrupt *>;
+        for (unsigned k = 0; k < n; k++) {
+            matched[k]->when = whens[k];
+            pending->SortedInsert(matched[k], whens[k]);
+            DEBUG('i', "Re-scheduling the %s at time %lu\n",
+                  INT_TYPE_NAMES[types[k]], whens[k]);
+        }
+    }
+
+    delete [] current;
+    delete [] matched;
+    return ok;
+}
+
 /// Arrange for the CPU to be interrupted when simulated time reaches `now +
 /// when`.
 ///
@@ -130,6 +130,10 @@ public:
     // Print interrupt state.
     void DumpState();
 
+    /// Advance simulated time by `n` ticks of system code at once, to
+    /// charge for work the kernel does natively.
+    void AdvanceSystemTicks(unsigned long n);
+
 
     /// NOTE: the following are internal to the hardware simulation code.
     /// DO NOT call these directly.  I should make them “private”,
@@ -145,6 +149,31 @@ public:
     /// Advance simulated time.
     void OneTick();
 
+    /// Return how many user instructions can be executed, each followed by
+    /// its `OneTick`, before any pending interrupt becomes due.
+    unsigned long UserTicksBeforeDue() const;
+
+    /// Account for `n` user instructions at once.
+    ///
+    /// The effect is exactly that of calling `OneTick` `n` times in user
+    /// mode, provided that `n` does not exceed `UserTicksBeforeDue`.
+    void AdvanceUserTicks(unsigned long n);
+
+    /// Store the kind and the time of every pending interrupt, in the order
+    /// they are going to happen, into `types` and `whens`, which have room
+    /// for `max` entries.
+    ///
+    /// Return the number of pending interrupts, even if it exceeds `max`.
+    unsigned GetPending(IntType *types, unsigned long *whens, unsigned max);
+
+    /// Move the pending interrupts to the times in `whens`, matching them
+    /// by kind with `types`, in order.  Used to restore snapshots.
+    ///
+    /// Return false, changing nothing, if the `n` kinds in `types` are not
+    /// those of the interrupts currently pending.
+    bool SetPending(const IntType *types, const unsigned long *whens,
+                    unsigned n);
+
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
     List<PendingInterrupt *> *pending;  ///< The list of interrupts scheduled
@@ -159,6 +188,9 @@ private:
     /// Check if an interrupt is supposed to occur now.
     bool CheckIfDue(bool advanceClock);
 
+    /// Fire the interrupts that are due after advancing the time.
+    void FireDue(MachineStatus old);
+
     /// SetLevel, without advancing the simulated time.
     void ChangeLevel(IntStatus old,
                      IntStatus now);
@@ -0,0 +1,834 @@
+/// Routines to translate user code into host code at run time.
+///
+/// Translated blocks are functions following the host calling convention.
+/// They keep a pointer to the simulated registers in `rbx` and a pointer to
+/// the `Context` of the current execution in `r12`, and every simulated
+/// register lives in memory between two user instructions, so that the
+/// interpreter can be called at any point.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "jit.hh"
+#include "decode_cache.hh"
+#include "machine.hh"
+#include "system_dep.hh"
+#include "threads/system.hh"
+
+#include <stddef.h>
+
+
+/// Size of the buffer that holds generated code.  When it fills up, every
+/// translation is thrown away.
+static const size_t CODE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+/// Upper bound of the host code generated for a single user instruction;
+/// also enough for the prologue and the end of a block.
+static const unsigned MAX_INSTR_CODE = 384;
+
+/// Number of times a block is interpreted before it gets translated.
+static const unsigned HOT_THRESHOLD = 16;
+
+/// Host registers used by generated code, numbered as in x86 encodings.
+enum {
+    EAX = 0,
+    ECX = 1,
+    EDX = 2
+};
+
+bool
+Jit::IsAvailable()
+{
+#if defined(HOST_x86_64) && !defined(PRPOLICY_LRU)
+    // Reference bits kept by the LRU policy are updated on every single
+    // fetch, which translated code does not perform.
+    return !debug.IsEnabled('m') && !debug.IsEnabled('a')
+           && !debug.IsEnabled('i') && !debug.IsEnabled('T');
+#else
+    return false;
+#endif
+}
+
+Jit::Jit(Machine *m, int *regs, MMU *u)
+{
+    ASSERT(IsAvailable());
+    ASSERT(m != nullptr);
+    ASSERT(regs != nullptr);
+    ASSERT(u != nullptr);
+
+    machine     = m;
+    registers   = regs;
+    mmu         = u;
+    decodeCache = mmu->GetDecodeCache();
+    skip        = 0;
+
+    entries    = new Entry * [NUM_PHYS_PAGES];
+    codeBuffer = SystemDep::AllocExecutable(CODE_BUFFER_SIZE);
+    ASSERT(codeBuffer != nullptr);
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        entries[i] = nullptr;
+    }
+    Flush();
+}
+
+Jit::~Jit()
+{
+    SystemDep::DeallocExecutable(codeBuffer, CODE_BUFFER_SIZE);
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        delete [] entries[i];
+    }
+    delete [] entries;
+}
+
+void
+Jit::Flush()
+{
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        if (entries[i] == nullptr) {
+            continue;
+        }
+        for (unsigned j = 0; j < PAGE_SIZE / 4; j++) {
+            entries[i][j].code = nullptr;
+            entries[i][j].heat = 0;
+        }
+    }
+
+    // Every block returns through this epilogue, which restores the
+    // registers saved by its prologue.
+    codeNext = codeBuffer;
+    codeExit = codeNext;
+    EmitByte(0x5D);                  // pop  rbp
+    EmitByte(0x41); EmitByte(0x5C);  // pop  r12
+    EmitByte(0x5B);                  // pop  rbx
+    EmitByte(0xC3);                  // ret
+}
+
+/// Run the block at the current PC.
+///
+/// A block is only entered at an instruction that is not in a delay slot.
+/// The address of its first instruction is translated exactly as the
+/// interpreter would; the rest of the instructions are in the same page,
+/// whose translation cannot change while the block runs, since the kernel
+/// is not called in between.
+template <bool TLB>
+bool
+Jit::RunBlock()
+{
+    if (skip > 0) {
+        skip--;
+        return false;
+    }
+
+    unsigned pc = registers[PC_REG];
+    if ((unsigned) registers[NEXT_PC_REG] != pc + 4) {
+        return false;
+    }
+    // Either the interpreter or the block fetches the instruction again,
+    // so this translation does not count as a TLB hit or miss.  Nor does
+    // it refill the TLB: a miss is left for the interpreter.
+    unsigned long hits   = stats->numTlbHits;
+    unsigned long misses = stats->numTlbMisses;
+    bool walk = mmu->walkPageTable;
+    mmu->walkPageTable = false;
+    unsigned physAddr;
+    ExceptionType e = mmu->TranslateFetch<TLB>(pc, &physAddr);
+    mmu->walkPageTable  = walk;
+    stats->numTlbHits   = hits;
+    stats->numTlbMisses = misses;
+    if (e != NO_EXCEPTION) {
+        return false;  // Let the interpreter raise the exception.
+    }
+
+    unsigned frame = physAddr / PAGE_SIZE;
+    if (entries[frame] == nullptr) {
+        entries[frame] = new Entry [PAGE_SIZE / 4];
+        for (unsigned j = 0; j < PAGE_SIZE / 4; j++) {
+            entries[frame][j].code = nullptr;
+            entries[frame][j].heat = 0;
+        }
+    }
+    Entry *entry = &entries[frame][physAddr % PAGE_SIZE / 4];
+    unsigned long version = decodeCache->FrameVersion(frame);
+    if (entry->code == nullptr || entry->version != version
+          || entry->vaddr != pc) {
+        if (++entry->heat < HOT_THRESHOLD) {
+            skip = decodeCache->BlockLength(physAddr) - 1;
+            return false;
+        }
+        Translate(entry, pc, physAddr);
+    }
+
+    unsigned length = entry->length;
+    if (interrupt->UserTicksBeforeDue() < length) {
+        return false;
+    }
+
+    Context context;
+    context.jit         = this;
+    context.frame       = frame;
+    context.version     = version;
+    context.ticksDone   = 0;
+    context.fetchesDone = 0;
+    context.exception   = NO_EXCEPTION;
+    context.lastUse     = nullptr;
+    if (TLB) {
+        // `TranslateFetch` left the translation of `pc` in the host cache.
+        unsigned slot = pc / PAGE_SIZE % HOST_CACHE_SIZE;
+        context.lastUse = mmu->hostCache[false][slot].lastUse;
+    }
+
+    unsigned stop = entry->code(registers, &context);
+
+    if (context.exception != NO_EXCEPTION) {
+        // Same as a failed `ExecInstruction` in `Machine::Run`.
+        machine->DispatchException(context.exception);
+        interrupt->OneTick();
+        return true;
+    }
+
+    // The block may have stopped early, right after a store into its own
+    // code.
+    unsigned done = stop < length ? stop + 1 : length;
+    Account(&context, done, done);
+    return true;
+}
+
+void
+Jit::Account(Context *context, unsigned ticks, unsigned fetches)
+{
+    ASSERT(context != nullptr);
+
+    if (ticks > context->ticksDone) {
+        interrupt->AdvanceUserTicks(ticks - context->ticksDone);
+        context->ticksDone = ticks;
+    }
+    stats->numMemAccess += fetches - context->fetchesDone;
+    context->fetchesDone = fetches;
+}
+
+template <bool TLB>
+int
+Jit::Step(Context *context, unsigned index, const Instruction *instr)
+{
+    ASSERT(context != nullptr);
+    ASSERT(instr != nullptr);
+
+    // The statistics must be exact in case the instruction traps.
+    Account(context, index, index + 1);
+
+    Jit *jit = context->jit;
+    if (!jit->machine->ExecInstructionDeferred<TLB>(instr,
+                                                    &context->exception)) {
+        return 0;
+    }
+    return jit->decodeCache->FrameVersion(context->frame) == context->version;
+}
+
+void
+Jit::Translate(Entry *entry, unsigned vaddr, unsigned physAddr)
+{
+    ASSERT(entry != nullptr);
+
+    unsigned length = decodeCache->BlockLength(physAddr);
+    if (codeNext + (length + 1) * MAX_INSTR_CODE
+          > codeBuffer + CODE_BUFFER_SIZE) {
+        Flush();
+    }
+
+    // Delegated instructions go through the same MMU configuration as
+    // `RunBlock`.
+    StepHelper step = mmu->tlb != nullptr ? Step<true> : Step<false>;
+
+    char *start = codeNext;
+    EmitByte(0x53);                                  // push rbx
+    EmitByte(0x41); EmitByte(0x54);                  // push r12
+    EmitByte(0x55);                                  // push rbp
+    EmitByte(0x48); EmitByte(0x89); EmitByte(0xFB);  // mov  rbx, rdi
+    EmitByte(0x49); EmitByte(0x89); EmitByte(0xF4);  // mov  r12, rsi
+
+    // What is known at translation time about the state in memory before
+    // each instruction:
+    bool pcSynced     = true;   // `PC_REG` and friends are up to date.
+    bool nextInMemory = false;  // `NEXT_PC_REG` was set by a branch.
+    bool loadPending  = true;   // A delayed load may be in progress.
+    bool lastInline   = false;
+    bool lastInSlot   = false;
+
+    unsigned pc = vaddr;
+    for (unsigned i = 0; i < length; i++, pc += 4) {
+        const Instruction *instr = decodeCache->Lookup(physAddr + i * 4);
+        bool inSlot = nextInMemory;
+        char *instrStart = codeNext;
+
+        if (mmu->tlb != nullptr) {
+            EmitFetchHit();
+        }
+
+        if (CanInline(instr, inSlot)) {
+            EmitInline(instr, pc);
+            if (loadPending) {
+                EmitCompleteLoad();
+                loadPending = false;
+            }
+            pcSynced = false;
+            lastInline = true;
+        } else if (CanAccessDirectly(instr, inSlot)) {
+            EmitDirectAccess(instr, i, pc, pcSynced, loadPending, step);
+            // Only the fallback updates the PC registers in memory.
+            pcSynced = false;
+            loadPending = instr->opCode == OP_LW;
+            lastInline = true;
+        } else {
+            if (!pcSynced) {
+                EmitSyncPC(pc, nextInMemory);
+            }
+            EmitStep(i, instr, step);
+            pcSynced = true;
+            loadPending = true;
+            lastInline = false;
+        }
+        nextInMemory = HasDelaySlot(instr->opCode);
+        lastInSlot = inSlot;
+        ASSERT(codeNext <= instrStart + MAX_INSTR_CODE);
+    }
+
+    if (lastInline) {
+        unsigned last = pc - 4;
+        if (lastInSlot) {
+            // Jump to wherever the branch decided.
+            EmitLoad(EAX, NEXT_PC_REG);
+            EmitStore(PC_REG, EAX);
+            EmitByte(0x05); EmitWord(4);  // add  eax, 4
+            EmitStore(NEXT_PC_REG, EAX);
+        } else {
+            EmitStoreImm(PC_REG, pc);
+            if (!nextInMemory) {
+                EmitStoreImm(NEXT_PC_REG, pc + 4);
+            }
+        }
+        EmitStoreImm(PREV_PC_REG, last);
+    }
+    EmitByte(0xB8); EmitWord(length);                    // mov  eax, length
+    EmitByte(0xE9); EmitWord(codeExit - (codeNext + 4));  // jmp  exit
+
+    ASSERT(codeNext <= start + (length + 1) * MAX_INSTR_CODE);
+
+    entry->code    = (Block) start;
+    entry->vaddr   = vaddr;
+    entry->length  = length;
+    entry->version = decodeCache->FrameVersion(physAddr / PAGE_SIZE);
+    entry->heat    = 0;
+}
+
+bool
+Jit::CanInline(const Instruction *instr, bool delaySlot)
+{
+    ASSERT(instr != nullptr);
+
+    switch (instr->opCode) {
+        case OP_ADDIU:
+        case OP_ADDU:
+        case OP_AND:
+        case OP_ANDI:
+        case OP_LUI:
+        case OP_MFHI:
+        case OP_MFLO:
+        case OP_MTHI:
+        case OP_MTLO:
+        case OP_NOR:
+        case OP_OR:
+        case OP_ORI:
+        case OP_SLL:
+        case OP_SLLV:
+        case OP_SLT:
+        case OP_SLTI:
+        case OP_SLTIU:
+        case OP_SLTU:
+        case OP_SRA:
+        case OP_SRAV:
+        case OP_SRL:
+        case OP_SRLV:
+        case OP_SUBU:
+        case OP_XOR:
+        case OP_XORI:
+            return true;
+
+        case OP_BEQ:
+        case OP_BGEZ:
+        case OP_BGEZAL:
+        case OP_BGTZ:
+        case OP_BLEZ:
+        case OP_BLTZ:
+        case OP_BLTZAL:
+        case OP_BNE:
+        case OP_J:
+        case OP_JAL:
+        case OP_JR:
+            // A branch in a delay slot is left to the interpreter, whatever
+            // it makes of it.
+            return !delaySlot;
+
+        case OP_JALR:
+            // Linking into R0 is only visible through `rs`; not worth it.
+            return !delaySlot && instr->rd != 0;
+
+        default:
+            return false;
+    }
+}
+
+bool
+Jit::CanAccessDirectly(const Instruction *instr, bool delaySlot)
+{
+    ASSERT(instr != nullptr);
+
+    return (instr->opCode == OP_LW || instr->opCode == OP_SW) && !delaySlot;
+}
+
+/// Emit a word load or store that looks up the host translation cache of
+/// the MMU (see `MMU::LookupHostCache`) and, on a hit, accesses
+/// `mainMemory` right away, setting the use and dirty bits and counting
+/// the memory access like `Machine::ReadMem`.
+///
+/// Everything else (unaligned addresses, misses, stores into a frame that
+/// holds decoded instructions) is handed to the interpreter, which may
+/// raise an exception or stop the block.  Both paths leave the same state
+/// in memory, except for the PC registers, which only the interpreter
+/// updates.
+void
+Jit::EmitDirectAccess(const Instruction *instr, unsigned index, unsigned pc,
+                      bool pcSynced, bool loadPending, StepHelper step)
+{
+    ASSERT(instr != nullptr);
+    ASSERT(PAGE_SIZE > 0 && (PAGE_SIZE & (PAGE_SIZE - 1)) == 0);
+    ASSERT((HOST_CACHE_SIZE & (HOST_CACHE_SIZE - 1)) == 0);
+
+    bool writing = instr->opCode == OP_SW;
+    unsigned pageShift = 0;
+    while (1U << pageShift != PAGE_SIZE) {
+        pageShift++;
+    }
+    char *misses[4];
+    unsigned numMisses = 0;
+
+    // Virtual address in `eax`, page number in `ecx`.
+    EmitLoad(EAX, instr->rs);
+    EmitByte(0x05); EmitWord(instr->extra);               // add  eax, extra
+    EmitByte(0xA8); EmitByte(0x03);                        // test al, 3
+    misses[numMisses++] = EmitJump(0x85);                  // jnz  miss
+    EmitByte(0x89); EmitByte(0xC1);                        // mov  ecx, eax
+    EmitByte(0xC1); EmitByte(0xE9); EmitByte(pageShift);   // shr  ecx, shift
+
+    // Cache entry in `rsi`.
+    EmitByte(0x89); EmitByte(0xCA);                        // mov  edx, ecx
+    EmitByte(0x81); EmitByte(0xE2); EmitWord(HOST_CACHE_SIZE - 1);
+                                                           // and  edx, size-1
+    EmitByte(0x69); EmitByte(0xD2);
+    EmitWord(sizeof (MMU::HostTranslation));               // imul edx, edx, size
+    EmitByte(0x48); EmitByte(0xBE);
+    EmitPointer(mmu->hostCache[writing]);                  // mov  rsi, cache
+    EmitByte(0x48); EmitByte(0x01); EmitByte(0xD6);        // add  rsi, rdx
+    EmitByte(0x48); EmitByte(0xBF); EmitPointer(&mmu->hostEpoch);
+                                                           // mov  rdi, &epoch
+    EmitByte(0x48); EmitByte(0x8B); EmitByte(0x3F);        // mov  rdi, [rdi]
+    EmitByte(0x48); EmitByte(0x39); EmitByte(0xBE);
+    EmitWord(offsetof(MMU::HostTranslation, epoch));       // cmp  [rsi+epoch], rdi
+    misses[numMisses++] = EmitJump(0x85);                  // jne  miss
+    EmitByte(0x39); EmitByte(0x8E);
+    EmitWord(offsetof(MMU::HostTranslation, vpn));         // cmp  [rsi+vpn], ecx
+    misses[numMisses++] = EmitJump(0x85);                  // jne  miss
+
+    // Host address of the frame in `rsi`; under a TLB, where to record
+    // the hit in `r8`.
+    EmitByte(0x48); EmitByte(0x8B); EmitByte(0xBE);
+    EmitWord(offsetof(MMU::HostTranslation, entry));       // mov  rdi, [rsi+entry]
+    if (mmu->tlb != nullptr) {
+        EmitByte(0x4C); EmitByte(0x8B); EmitByte(0x86);
+        EmitWord(offsetof(MMU::HostTranslation, lastUse)); // mov  r8, [rsi+lastUse]
+    }
+    EmitByte(0x48); EmitByte(0x8B); EmitByte(0xB6);
+    EmitWord(offsetof(MMU::HostTranslation, page));        // mov  rsi, [rsi+page]
+
+    if (writing) {
+        // The frame must not hold decoded instructions, otherwise they
+        // have to be invalidated, and maybe the block stopped.
+        EmitByte(0x48); EmitByte(0x89); EmitByte(0xF2);    // mov  rdx, rsi
+        EmitByte(0x48); EmitByte(0xB9); EmitPointer(mmu->mainMemory);
+                                                           // mov  rcx, memory
+        EmitByte(0x48); EmitByte(0x29); EmitByte(0xCA);    // sub  rdx, rcx
+        EmitByte(0x48); EmitByte(0xC1); EmitByte(0xEA);
+        EmitByte(pageShift);                               // shr  rdx, shift
+        EmitByte(0x48); EmitByte(0xB9); EmitPointer(decodeCache->frames);
+                                                           // mov  rcx, frames
+        EmitByte(0x48); EmitByte(0x8B); EmitByte(0x0C); EmitByte(0xD1);
+                                                           // mov  rcx, [rcx+rdx*8]
+        EmitByte(0x48); EmitByte(0x85); EmitByte(0xC9);    // test rcx, rcx
+        EmitByte(0x74); EmitByte(0x10);                    // jz   +16
+        EmitByte(0x81); EmitByte(0xB9);
+        EmitWord(offsetof(DecodeCache::FrameCode, numValid));
+        EmitWord(0);                                       // cmp  [rcx+numValid], 0
+        misses[numMisses++] = EmitJump(0x85);              // jne  miss
+    }
+
+    EmitByte(0xC6); EmitByte(0x87);
+    EmitWord(offsetof(TranslationEntry, use)); EmitByte(1);
+                                                           // mov  [rdi+use], 1
+    if (writing) {
+        EmitByte(0xC6); EmitByte(0x87);
+        EmitWord(offsetof(TranslationEntry, dirty)); EmitByte(1);
+                                                           // mov  [rdi+dirty], 1
+    }
+    if (mmu->tlb != nullptr) {
+        EmitCountHit();
+        EmitByte(0x49); EmitByte(0x89); EmitByte(0x10);    // mov  [r8], rdx
+    }
+    EmitByte(0x25); EmitWord(PAGE_SIZE - 1);               // and  eax, size-1
+    if (writing) {
+        EmitLoad(ECX, instr->rt);
+        EmitByte(0x89); EmitByte(0x0C); EmitByte(0x06);    // mov  [rsi+rax], ecx
+    } else {
+        EmitByte(0x8B); EmitByte(0x14); EmitByte(0x06);    // mov  edx, [rsi+rax]
+        EmitByte(0x48); EmitByte(0xB8); EmitPointer(&stats->numMemAccess);
+                                                           // mov  rax, &count
+        EmitByte(0x48); EmitByte(0xFF); EmitByte(0x00);    // inc  qword [rax]
+    }
+
+    // Same as `Machine::DelayedLoad`.
+    if (loadPending) {
+        EmitCompleteLoad();
+    }
+    if (!writing) {
+        EmitStoreImm(LOAD_REG, instr->rt);
+        EmitStore(LOAD_VALUE_REG, EDX);
+    }
+    char *done = EmitJump(0);                              // jmp  done
+
+    for (unsigned i = 0; i < numMisses; i++) {
+        PatchJump(misses[i]);
+    }
+    if (!pcSynced) {
+        EmitSyncPC(pc, false);
+    }
+    EmitStep(index, instr, step);
+    PatchJump(done);
+}
+
+/// Emit the computation of `instr`.
+///
+/// Writes to R0 are simply left out, since the interpreter would clear it
+/// right away.  Shifts right are arithmetic, as in `ExecInstruction`.
+void
+Jit::EmitInline(const Instruction *instr, unsigned pc)
+{
+    ASSERT(instr != nullptr);
+
+    unsigned rs = instr->rs, rt = instr->rt, rd = instr->rd;
+    unsigned imm = instr->extra;
+    unsigned notTaken = pc + 8;
+    unsigned taken = pc + 4 + IndexToAddr(imm);
+    unsigned cmov;
+
+    switch (instr->opCode) {
+        case OP_ADDU:
+        case OP_AND:
+        case OP_NOR:
+        case OP_OR:
+        case OP_SUBU:
+        case OP_XOR:
+            if (rd == 0) {
+                break;
+            }
+            EmitLoad(EAX, rs);
+            switch (instr->opCode) {
+                case OP_ADDU: EmitOp(0x03, EAX, rt); break;  // add
+                case OP_AND:  EmitOp(0x23, EAX, rt); break;  // and
+                case OP_SUBU: EmitOp(0x2B, EAX, rt); break;  // sub
+                case OP_XOR:  EmitOp(0x33, EAX, rt); break;  // xor
+                default:      EmitOp(0x0B, EAX, rt); break;  // or
+            }
+            if (instr->opCode == OP_NOR) {
+                EmitByte(0xF7); EmitByte(0xD0);  // not  eax
+            }
+            EmitStore(rd, EAX);
+            break;
+
+        case OP_ADDIU:
+        case OP_ANDI:
+        case OP_ORI:
+        case OP_XORI:
+            if (rt == 0) {
+                break;
+            }
+            EmitLoad(EAX, rs);
+            switch (instr->opCode) {
+                case OP_ADDIU: EmitByte(0x05); EmitWord(imm);          break;
+                case OP_ANDI:  EmitByte(0x25); EmitWord(imm & 0xFFFF); break;
+                case OP_ORI:   EmitByte(0x0D); EmitWord(imm & 0xFFFF); break;
+                default:       EmitByte(0x35); EmitWord(imm & 0xFFFF); break;
+            }
+            EmitStore(rt, EAX);
+            break;
+
+        case OP_LUI:
+            if (rt != 0) {
+                EmitStoreImm(rt, imm << 16);
+            }
+            break;
+
+        case OP_SLL:
+        case OP_SRA:
+        case OP_SRL:
+            if (rd == 0) {
+                break;
+            }
+            EmitLoad(EAX, rt);
+            EmitByte(0xC1);
+            EmitByte(instr->opCode == OP_SLL ? 0xE0 : 0xF8);  // shl/sar
+            EmitByte(imm);
+            EmitStore(rd, EAX);
+            break;
+
+        case OP_SLLV:
+        case OP_SRAV:
+        case OP_SRLV:
+            if (rd == 0) {
+                break;
+            }
+            EmitLoad(ECX, rs);
+            EmitLoad(EAX, rt);
+            EmitByte(0xD3);
+            EmitByte(instr->opCode == OP_SLLV ? 0xE0 : 0xF8);  // shl/sar cl
+            EmitStore(rd, EAX);
+            break;
+
+        case OP_SLT:
+        case OP_SLTU:
+        case OP_SLTI:
+        case OP_SLTIU: {
+            bool immediate = instr->opCode == OP_SLTI
+                             || instr->opCode == OP_SLTIU;
+            bool isSigned = instr->opCode == OP_SLT
+                            || instr->opCode == OP_SLTI;
+            unsigned dest = immediate ? rt : rd;
+            if (dest == 0) {
+                break;
+            }
+            EmitLoad(EAX, rs);
+            if (immediate) {
+                EmitByte(0x3D); EmitWord(imm);  // cmp  eax, imm
+            } else {
+                EmitOp(0x3B, EAX, rt);          // cmp  eax, [rt]
+            }
+            EmitByte(0x0F); EmitByte(isSigned ? 0x9C : 0x92);
+            EmitByte(0xC0);                                   // setl/setb al
+            EmitByte(0x0F); EmitByte(0xB6); EmitByte(0xC0);  // movzx eax, al
+            EmitStore(dest, EAX);
+            break;
+        }
+
+        case OP_MFHI:
+        case OP_MFLO:
+            if (rd != 0) {
+                EmitLoad(EAX, instr->opCode == OP_MFHI ? HI_REG : LO_REG);
+                EmitStore(rd, EAX);
+            }
+            break;
+
+        case OP_MTHI:
+        case OP_MTLO:
+            EmitLoad(EAX, rs);
+            EmitStore(instr->opCode == OP_MTHI ? HI_REG : LO_REG, EAX);
+            break;
+
+        case OP_J:
+        case OP_JAL:
+            if (instr->opCode == OP_JAL) {
+                EmitStoreImm(RET_ADDR_REG, pc + 8);
+            }
+            EmitStoreImm(NEXT_PC_REG,
+                         (notTaken & 0xF0000000) | IndexToAddr(imm));
+            break;
+
+        case OP_JALR:
+        case OP_JR:
+            // The link register is written before `rs` is read.
+            if (instr->opCode == OP_JALR) {
+                EmitStoreImm(rd, pc + 8);
+            }
+            EmitLoad(EAX, rs);
+            EmitStore(NEXT_PC_REG, EAX);
+            break;
+
+        default:  // Conditional branches.
+            if (instr->opCode == OP_BGEZAL || instr->opCode == OP_BLTZAL) {
+                EmitStoreImm(RET_ADDR_REG, pc + 8);
+            }
+            EmitByte(0xB9); EmitWord(notTaken);  // mov  ecx, notTaken
+            EmitByte(0xBA); EmitWord(taken);     // mov  edx, taken
+            EmitLoad(EAX, rs);
+            switch (instr->opCode) {
+                case OP_BEQ:    cmov = 0x44; break;  // cmove
+                case OP_BNE:    cmov = 0x45; break;  // cmovne
+                case OP_BGTZ:   cmov = 0x4F; break;  // cmovg
+                case OP_BLEZ:   cmov = 0x4E; break;  // cmovle
+                case OP_BLTZ:
+                case OP_BLTZAL: cmov = 0x48; break;  // cmovs
+                default:        cmov = 0x49; break;  // cmovns
+            }
+            if (instr->opCode == OP_BEQ || instr->opCode == OP_BNE) {
+                EmitOp(0x3B, EAX, rt);            // cmp  eax, [rt]
+            } else {
+                EmitByte(0x85); EmitByte(0xC0);  // test eax, eax
+            }
+            EmitByte(0x0F); EmitByte(cmov); EmitByte(0xCA);  // cmovcc ecx, edx
+            EmitStore(NEXT_PC_REG, ECX);
+            break;
+    }
+}
+
+void
+Jit::EmitCountHit()
+{
+    EmitByte(0x48); EmitByte(0xB9); EmitPointer(&stats->numTlbHits);
+                                                      // mov  rcx, &hits
+    EmitByte(0x48); EmitByte(0x8B); EmitByte(0x11);   // mov  rdx, [rcx]
+    EmitByte(0x48); EmitByte(0xFF); EmitByte(0xC2);   // inc  rdx
+    EmitByte(0x48); EmitByte(0x89); EmitByte(0x11);   // mov  [rcx], rdx
+}
+
+void
+Jit::EmitFetchHit()
+{
+    EmitCountHit();
+    EmitByte(0x49); EmitByte(0x8B); EmitByte(0x8C); EmitByte(0x24);
+    EmitWord(offsetof(Context, lastUse));             // mov  rcx, [r12+lastUse]
+    EmitByte(0x48); EmitByte(0x89); EmitByte(0x11);   // mov  [rcx], rdx
+}
+
+/// Complete a delayed load that may be in progress, exactly like
+/// `Machine::DelayedLoad(0, 0)`.
+void
+Jit::EmitCompleteLoad()
+{
+    EmitLoad(EAX, LOAD_REG);
+    EmitLoad(ECX, LOAD_VALUE_REG);
+    EmitByte(0x89); EmitByte(0x0C); EmitByte(0x83);  // mov  [rbx+rax*4], ecx
+    EmitByte(0x31); EmitByte(0xC9);                  // xor  ecx, ecx
+    EmitStore(LOAD_REG, ECX);
+    EmitStore(LOAD_VALUE_REG, ECX);
+    EmitStore(0, ECX);
+}
+
+/// Store the PC registers as they are right before the instruction at
+/// `pc`; `NEXT_PC_REG` is left alone if a branch already set it.
+void
+Jit::EmitSyncPC(unsigned pc, bool nextInMemory)
+{
+    EmitStoreImm(PC_REG, pc);
+    EmitStoreImm(PREV_PC_REG, pc - 4);
+    if (!nextInMemory) {
+        EmitStoreImm(NEXT_PC_REG, pc + 4);
+    }
+}
+
+/// Emit a call to `step` for instruction number `index`, leaving the block
+/// if it returns 0.
+void
+Jit::EmitStep(unsigned index, const Instruction *instr, StepHelper step)
+{
+    EmitByte(0x4C); EmitByte(0x89); EmitByte(0xE7);  // mov  rdi, r12
+    EmitByte(0xBE); EmitWord(index);                  // mov  esi, index
+    EmitByte(0x48); EmitByte(0xBA); EmitPointer(instr);
+                                                      // mov  rdx, instr
+    EmitByte(0x48); EmitByte(0xB8); EmitPointer((void *) step);
+                                                      // mov  rax, step
+    EmitByte(0xFF); EmitByte(0xD0);                   // call rax
+    EmitByte(0x85); EmitByte(0xC0);                   // test eax, eax
+    EmitByte(0x75); EmitByte(0x0A);                   // jnz  +10
+    EmitByte(0xB8); EmitWord(index);                  // mov  eax, index
+    EmitByte(0xE9); EmitWord(codeExit - (codeNext + 4));
+                                                      // jmp  exit
+}
+
+char *
+Jit::EmitJump(unsigned condition)
+{
+    if (condition == 0) {
+        EmitByte(0xE9);
+    } else {
+        EmitByte(0x0F); EmitByte(condition);
+    }
+    char *jump = codeNext;
+    EmitWord(0);
+    return jump;
+}
+
+void
+Jit::PatchJump(char *jump)
+{
+    ASSERT(jump != nullptr);
+
+    unsigned displacement = codeNext - (jump + 4);
+    for (unsigned i = 0; i < 4; i++) {
+        jump[i] = (char) (displacement >> 8 * i & 0xFF);
+    }
+}
+
+void
+Jit::EmitByte(unsigned byte)
+{
+    *codeNext++ = (char) byte;
+}
+
+/// Emit a 32-bit little-endian value.
+void
+Jit::EmitWord(unsigned word)
+{
+    for (unsigned i = 0; i < 4; i++) {
+        EmitByte(word >> 8 * i & 0xFF);
+    }
+}
+
+void
+Jit::EmitPointer(const void *pointer)
+{
+    unsigned long value = (unsigned long) pointer;
+    EmitWord(value & 0xFFFFFFFF);
+    EmitWord(value >> 32);
+}
+
+/// Emit an instruction with `opCode` that operates between host register
+/// `hostReg` and simulated register `reg`, that is `[rbx + reg * 4]`.
+void
+Jit::EmitOp(unsigned opCode, unsigned hostReg, unsigned reg)
+{
+    ASSERT(reg < NUM_TOTAL_REGS);
+
+    EmitByte(opCode);
+    EmitByte(0x80 | hostReg << 3 | 3);  // Register and `[rbx + disp32]`.
+    EmitWord(reg * 4);
+}
+
+void
+Jit::EmitLoad(unsigned hostReg, unsigned reg)
+{
+    EmitOp(0x8B, hostReg, reg);  // mov  hostReg, [reg]
+}
+
+void
+Jit::EmitStore(unsigned reg, unsigned hostReg)
+{
+    EmitOp(0x89, hostReg, reg);  // mov  [reg], hostReg
+}
+
+void
+Jit::EmitStoreImm(unsigned reg, unsigned value)
+{
+    EmitOp(0xC7, 0, reg);  // mov  dword [reg], value
+    EmitWord(value);
+}
+
+template bool Jit::RunBlock<false>();
+template bool Jit::RunBlock<true>();
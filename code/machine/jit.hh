@@ -0,0 +1,207 @@
+/// Data structures for translating user code into host code at run time.
+///
+/// The simulator spends most of its time on the bookkeeping around each
+/// user instruction rather than on the instruction itself: fetching and
+/// translating the PC, dispatching on the opcode, and calling
+/// `Interrupt::OneTick`.  When enabled (see the `-j` flag), this engine
+/// translates basic blocks that are executed often into host (x86-64)
+/// code, and runs a whole block at a time.
+///
+/// Translated code keeps every observable behavior of the interpreter:
+///
+/// * Simple arithmetic, logic and branch instructions are translated
+///   inline, including the delayed load that each of them completes and
+///   the update of the PC registers.  Everything else (memory accesses,
+///   multiplication, division, instructions that may overflow, traps) is
+///   delegated to `Machine::ExecInstruction` through a helper call.
+/// * Word loads and stores are the exception: as long as their page is in
+///   the host translation cache of the MMU, they access `mainMemory`
+///   directly, and only fall back to the interpreter on a miss.
+/// * A block only runs if no interrupt can become due before it ends, and
+///   its ticks are accounted for with `Interrupt::AdvanceUserTicks`, so the
+///   sequence of simulated times is the same as if each instruction had
+///   been followed by its own `OneTick`.
+/// * Exceptions raised by delegated instructions are not handed to the
+///   kernel from inside translated code.  The block stops right there, the
+///   statistics are brought up to date, and only then the handler is
+///   called, followed by the `OneTick` of the faulting instruction.
+/// * Blocks are keyed by physical address and are discarded whenever the
+///   frame they were translated from changes (see
+///   `DecodeCache::FrameVersion`).
+///
+/// On hosts other than x86-64 nothing is ever translated, and the machine
+/// simply keeps interpreting.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_JIT__HH
+#define NACHOS_MACHINE_JIT__HH
+
+
+#include "exception_type.hh"
+
+#include <stddef.h>
+
+
+class DecodeCache;
+class Instruction;
+class Machine;
+class MMU;
+
+class Jit {
+public:
+
+    /// Return whether translated code can be run on this host.
+    ///
+    /// Translation is also unavailable while machine, address space or
+    /// interrupt debugging messages are enabled, since those are printed
+    /// for every single instruction.
+    static bool IsAvailable();
+
+    /// Initialize an engine for `machine`, whose CPU registers are
+    /// `registers` and whose memory management unit is `mmu`.
+    Jit(Machine *machine, int *registers, MMU *mmu);
+
+    /// De-allocate the engine and all the code it generated.
+    ~Jit();
+
+    /// Run the block that starts at the current PC, if it is already
+    /// translated (or hot enough to be translated now) and it fits before
+    /// the next interrupt.
+    ///
+    /// Return false if nothing was executed, in which case the caller must
+    /// interpret the next instruction itself.
+    ///
+    /// `TLB` tells whether the MMU translates through a TLB, as in
+    /// `Machine::RunLoop`.
+    template <bool TLB>
+    bool RunBlock();
+
+private:
+
+    /// State of one execution of a translated block.
+    ///
+    /// It lives in the stack of the thread running the block, so that the
+    /// same engine can be used by every thread.
+    struct Context {
+        Jit *jit;
+        unsigned frame;           ///< Frame the block was translated from.
+        unsigned long version;    ///< Version of `frame` at translation.
+        unsigned ticksDone;       ///< Instructions already accounted for.
+        unsigned fetchesDone;     ///< Fetches already accounted for.
+        ExceptionType exception;  ///< Exception that stopped the block.
+        unsigned long *lastUse;   ///< Where the MMU records hits on the TLB
+                                  ///< entry of the block, if any.
+    };
+
+    /// Signature of a translated block.  Returns the index of the
+    /// instruction where execution stopped, or the length of the block.
+    typedef unsigned (*Block)(int *registers, Context *context);
+
+    /// Signature of `Step`.
+    typedef int (*StepHelper)(Context *context, unsigned index,
+                              const Instruction *instr);
+
+    /// Translation state of a single word of physical memory.
+    struct Entry {
+        Block code;             ///< Null if not translated.
+        unsigned vaddr;         ///< Virtual address it was translated for.
+        unsigned length;        ///< Number of instructions in the block.
+        unsigned long version;  ///< Version of the frame at translation.
+        unsigned heat;          ///< Interpreted executions since then.
+    };
+
+    /// Translate the block at virtual address `vaddr`, which is stored at
+    /// physical address `physAddr`, into `entry`.
+    void Translate(Entry *entry, unsigned vaddr, unsigned physAddr);
+
+    /// Forget every translated block and reuse the whole code buffer.
+    void Flush();
+
+    /// Bring the tick and memory access counters up to `ticks` executed
+    /// instructions and `fetches` fetched ones.
+    static void Account(Context *context, unsigned ticks, unsigned fetches);
+
+    /// Called from translated code to run instruction number `index` of the
+    /// current block with the interpreter.
+    ///
+    /// Return 0 if the block must stop.
+    template <bool TLB>
+    static int Step(Context *context, unsigned index,
+                    const Instruction *instr);
+
+    /// Emitters of host code, writing at `codeNext`.
+
+    void EmitByte(unsigned byte);
+    void EmitWord(unsigned word);
+    void EmitPointer(const void *pointer);
+    void EmitOp(unsigned opCode, unsigned hostReg, unsigned reg);
+    void EmitLoad(unsigned hostReg, unsigned reg);
+    void EmitStore(unsigned reg, unsigned hostReg);
+    void EmitStoreImm(unsigned reg, unsigned value);
+    void EmitCompleteLoad();
+    void EmitSyncPC(unsigned pc, bool nextInMemory);
+    void EmitStep(unsigned index, const Instruction *instr, StepHelper step);
+
+    /// Count a hit in the TLB, exactly as the MMU does, leaving the new
+    /// number of hits in `rdx` so that the caller records it.
+    void EmitCountHit();
+
+    /// Count the fetch of an instruction of the block as a hit on its TLB
+    /// entry, as `MMU::FetchInstruction` would.
+    void EmitFetchHit();
+
+    /// Emit a jump with a 32-bit displacement (`jmp` if `condition` is 0,
+    /// otherwise the `jcc` whose second opcode byte is `condition`), to be
+    /// resolved later with `PatchJump`.
+    char *EmitJump(unsigned condition);
+
+    /// Make the jump emitted at `jump` land on `codeNext`.
+    void PatchJump(char *jump);
+
+    /// Return whether `instr` can be translated inline; otherwise it is
+    /// delegated to the interpreter.
+    static bool CanInline(const Instruction *instr, bool delaySlot);
+
+    /// Emit the inline translation of `instr`, located at `pc`, except for
+    /// the pending delayed load and the PC registers, which are left to the
+    /// caller.
+    void EmitInline(const Instruction *instr, unsigned pc);
+
+    /// Return whether `instr` is a memory access that can be done straight
+    /// on `mainMemory` when its page is in the host translation cache of
+    /// the MMU.
+    static bool CanAccessDirectly(const Instruction *instr, bool delaySlot);
+
+    /// Emit `instr`, instruction number `index` of the block, located at
+    /// `pc`, as a direct access to `mainMemory` that falls back to `step`
+    /// whenever the host translation cache misses.
+    ///
+    /// `pcSynced` and `loadPending` describe the state before the
+    /// instruction, as in `Translate`.
+    void EmitDirectAccess(const Instruction *instr, unsigned index,
+                          unsigned pc, bool pcSynced, bool loadPending,
+                          StepHelper step);
+
+    Machine *machine;
+    int *registers;
+    MMU *mmu;
+    DecodeCache *decodeCache;
+
+    /// For every frame of physical memory, one entry per word, or null if
+    /// nothing was ever run from it.
+    Entry **entries;
+
+    char *codeBuffer;  ///< Memory holding the generated code.
+    char *codeNext;    ///< First free byte in `codeBuffer`.
+    char *codeExit;    ///< Shared epilogue of every block.
+
+    /// Number of upcoming calls to `RunBlock` to be skipped, because the
+    /// interpreter is running through a block that is not hot yet.
+    unsigned skip;
+};
+
+
+#endif
@@ -9,6 +9,7 @@
 
 
 #include "machine.hh"
+#include "jit.hh"
 #include "threads/system.hh"
 
 
@@ -45,7 +46,9 @@ CheckEndian()
 /// * `st` -- pointer to an object that performs single stepping, for
 ///   dropping into it after each user instruction is executed; if null,
 ///   execute normally, without single stepping.
-Machine::Machine(SingleStepper *st)
+/// * `translate` -- if true, run hot blocks of user code translated into
+///   host code, whenever the host supports it.
+Machine::Machine(SingleStepper *st, bool translate)
 {
     for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
         registers[i] = 0;
@@ -57,6 +60,21 @@ Machine::Machine(SingleStepper *st)
 
     singleStepper = st;
     CheckEndian();
+
+    deferExceptions = false;
+    jit = nullptr;
+    if (translate) {
+        if (Jit::IsAvailable()) {
+            jit = new Jit(this, registers, &mmu);
+        } else {
+            DEBUG('m', "Code translation is not available, interpreting.\n");
+        }
+    }
+}
+
+Machine::~Machine()
+{
+    delete jit;
 }
 
 const int *
@@ -94,7 +112,22 @@ Machine::WriteRegister(unsigned num, int value)
 bool
 Machine::ReadMem(unsigned addr, unsigned size, int *value)
 {
-    ExceptionType e = mmu.ReadMem(addr, size, value);
+    return mmu.tlb != nullptr ? ReadMem<true, true>(addr, size, value)
+                              : ReadMem<true, false>(addr, size, value);
+}
+
+bool
+Machine::WriteMem(unsigned addr, unsigned size, int value)
+{
+    return mmu.tlb != nullptr ? WriteMem<true, true>(addr, size, value)
+                              : WriteMem<true, false>(addr, size, value);
+}
+
+template <bool TRACE, bool TLB>
+bool
+Machine::ReadMem(unsigned addr, unsigned size, int *value)
+{
+    ExceptionType e = mmu.ReadMem<TRACE, TLB>(addr, size, value);
     stats->numMemAccess++;
     if (e != NO_EXCEPTION) {
         RaiseException(e, addr);
@@ -103,10 +136,11 @@ Machine::ReadMem(unsigned addr, unsigned size, int *value)
     return true;
 }
 
+template <bool TRACE, bool TLB>
 bool
 Machine::WriteMem(unsigned addr, unsigned size, int value)
 {
-    ExceptionType e = mmu.WriteMem(addr, size, value);
+    ExceptionType e = mmu.WriteMem<TRACE, TLB>(addr, size, value);
     if (e != NO_EXCEPTION) {
         RaiseException(e, addr);
         return false;
@@ -114,6 +148,15 @@ Machine::WriteMem(unsigned addr, unsigned size, int value)
     return true;
 }
 
+template bool Machine::ReadMem<false, false>(unsigned, unsigned, int *);
+template bool Machine::ReadMem<false, true>(unsigned, unsigned, int *);
+template bool Machine::ReadMem<true, false>(unsigned, unsigned, int *);
+template bool Machine::ReadMem<true, true>(unsigned, unsigned, int *);
+template bool Machine::WriteMem<false, false>(unsigned, unsigned, int);
+template bool Machine::WriteMem<false, true>(unsigned, unsigned, int);
+template bool Machine::WriteMem<true, false>(unsigned, unsigned, int);
+template bool Machine::WriteMem<true, true>(unsigned, unsigned, int);
+
 /// Transfer control to the Nachos kernel from user mode, because the user
 /// program either invoked a system call, or some exception occured (such as
 /// the address translation failed).
@@ -132,10 +175,28 @@ Machine::RaiseException(ExceptionType et, unsigned badVAddr)
     registers[BAD_VADDR_REG] = badVAddr;
     DelayedLoad(0, 0);  // Finish anything in progress.
 
-    // Call the associated handler with interrupts enabled in system mode.
+    if (deferExceptions) {
+        deferredException = et;
+        return;
+    }
+    DispatchException(et);
+}
+
+/// Call the handler associated with `et` with interrupts enabled in system
+/// mode, and then go back to the mode the machine was in.  That is system
+/// mode when the kernel itself touched user memory, in a system call.
+void
+Machine::DispatchException(ExceptionType et)
+{
+    ASSERT(IsExceptionType(et));
+
+    MachineStatus old = interrupt->GetStatus();
     interrupt->SetStatus(SYSTEM_MODE);
     (*handlers[et])(et);
-    interrupt->SetStatus(USER_MODE);
+    interrupt->SetStatus(old);
+
+    // The handler may have changed any translation.
+    mmu.FlushHostCache();
 }
 
 void
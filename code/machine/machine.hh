@@ -49,6 +49,7 @@ enum {
 };
 
 class Instruction;
+class Jit;
 
 typedef void (*ExceptionHandler)(ExceptionType);
 
@@ -69,7 +70,10 @@ class Machine {
 public:
 
     /// Initialize the simulation of the hardware for running user programs.
-    Machine(SingleStepper *st);
+    Machine(SingleStepper *st, bool translate);
+
+    /// De-allocate the simulation.
+    ~Machine();
 
     /// Routines callable by the Nachos kernel.
 
@@ -93,18 +97,64 @@ public:
 
     bool WriteMem(unsigned addr, unsigned size, int value);
 
+    /// Variants of the above for a fixed configuration, see
+    /// `MMU::ReadMem`.
+
+    template <bool TRACE, bool TLB>
+    bool ReadMem(unsigned addr, unsigned size, int *value);
+
+    template <bool TRACE, bool TLB>
+    bool WriteMem(unsigned addr, unsigned size, int value);
+
     /// Print the user CPU and memory state.
     void DumpState();
 
     /// Routines internal to the machine simulation -- DO NOT call these.
 
-    /// Fetch one instruction of a user program.
+    /// The following ones are instantiated for a fixed configuration of
+    /// the simulator, so that the checks that do not depend on the running
+    /// program are resolved at compile time:
+    ///
+    /// * `STEP` -- whether `singleStepper` is set;
+    /// * `TRACE` -- whether any debugging message printed for every
+    ///   instruction is enabled;
+    /// * `TLB` -- whether the MMU translates through a TLB rather than
+    ///   through a linear page table.
+
+    /// Run user instructions while the configuration stays the same.
+    ///
+    /// Return once it changes, for instance when the single stepper
+    /// detaches or debugging messages are turned on or off, so that `Run`
+    /// can switch to the right instance.
+    template <bool STEP, bool TRACE, bool TLB>
+    void RunLoop();
+
+    /// Run up to `limit` instructions of a user program, as long as no
+    /// interrupt becomes due, accounting for their ticks at once.
+    ///
+    /// Return false if nothing could be run.
+    template <bool TLB>
+    bool RunBatch(unsigned long limit);
+
+    /// Fetch one instruction of a user program, already decoded.
     ///
     /// Return false if an exception occurs, true otherwise.
-    bool FetchInstruction(Instruction *instr);
+    template <bool TRACE, bool TLB>
+    bool FetchInstruction(const Instruction **instr);
 
     /// Run a certain instruction of a user program.
-    void ExecInstruction(const Instruction *instr);
+    ///
+    /// Return false if an exception occurs, true otherwise.
+    template <bool TRACE, bool TLB>
+    bool ExecInstruction(const Instruction *instr);
+
+    /// Run an instruction like `ExecInstruction`, but if it raises an
+    /// exception, do not trap to the kernel yet: store the exception type
+    /// in `*et` and return false.
+    ///
+    /// The exception must then be handed to `DispatchException`.
+    template <bool TLB>
+    bool ExecInstructionDeferred(const Instruction *instr, ExceptionType *et);
 
     /// Do a pending delayed load (modifying a reg).
     void DelayedLoad(unsigned nextReg, int nextVal);
@@ -113,6 +163,9 @@ public:
     /// exception.
     void RaiseException(ExceptionType et, unsigned badVAddr);
 
+    /// Call the handler of an exception already raised, in system mode.
+    void DispatchException(ExceptionType et);
+
     /// Register an exception handler: a callback kernel function to invoke
     /// when an exception of a certain type is raised.
     ///
@@ -132,6 +185,12 @@ private:
 
     MMU mmu; ///< Memory management unit.
 
+    Jit *jit;  ///< Engine running translated code, if enabled.
+
+    /// Set while running `ExecInstructionDeferred` or `RunBatch`.
+    bool deferExceptions;
+    ExceptionType deferredException;
+
     ExceptionHandler handlers[NUM_EXCEPTION_TYPES];  ///< Exception handlers.
 };
 
@@ -13,11 +13,22 @@
 
 #include "instruction.hh"
 #include "machine.hh"
+#include "jit.hh"
 #include "threads/system.hh"
 
+#include <limits.h>
 #include <stdio.h>
 
 
+/// Return whether debugging messages are printed for every single user
+/// instruction.
+static inline bool
+IsTracing()
+{
+    return debug.IsEnabled('m') || debug.IsEnabled('a')
+           || debug.IsEnabled('i') || debug.IsEnabled('T');
+}
+
 /// Simulate the execution of a user-level program on Nachos.
 ///
 /// Called by the kernel when the program starts up; never returns.
@@ -27,8 +38,17 @@
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;
-      // Storage for decoded instruction.
+    // Instances of `RunLoop`, indexed by `STEP`, `TRACE` and `TLB`.
+    static void (Machine::*const LOOPS[2][2][2])() = {
+        { { &Machine::RunLoop<false, false, false>,
+            &Machine::RunLoop<false, false, true> },
+          { &Machine::RunLoop<false, true, false>,
+            &Machine::RunLoop<false, true, true> } },
+        { { &Machine::RunLoop<true, false, false>,
+            &Machine::RunLoop<true, false, true> },
+          { &Machine::RunLoop<true, true, false>,
+            &Machine::RunLoop<true, true, true> } }
+    };
 
     if (debug.IsEnabled('m')) {
         printf("Starting to run at time %lu\n", stats->totalTicks);
@@ -36,16 +56,96 @@ Machine::Run()
     interrupt->SetStatus(USER_MODE);
 
     for (;;) {
-        if (FetchInstruction(instr)) {
-            ExecInstruction(instr);
+        (this->*LOOPS[singleStepper != nullptr]
+                     [IsTracing()]
+                     [mmu.tlb != nullptr])();
+    }
+}
+
+template <bool STEP, bool TRACE, bool TLB>
+void
+Machine::RunLoop()
+{
+    const Instruction *instr;  // Decoded instruction, owned by the MMU.
+
+    for (;;) {
+        // Ticks are accounted for in bulk, unless every tick has to be
+        // shown or the stepper has to see every instruction.
+        if (!STEP && !TRACE) {
+            if (jit != nullptr && jit->RunBlock<TLB>()) {
+                continue;  // A whole block was run, ticks included.
+            }
+            if (RunBatch<TLB>(jit == nullptr ? ULONG_MAX : 1)) {
+                continue;
+            }
+        }
+        if (FetchInstruction<TRACE, TLB>(&instr)) {
+            ExecInstruction<TRACE, TLB>(instr);
         }
         interrupt->OneTick();
-        if (singleStepper != nullptr && !singleStepper->Step()) {
-            singleStepper = nullptr;
+        if (STEP) {
+            // The stepper is shared by every thread, so it may have been
+            // detached by another one during `OneTick`.
+            if (singleStepper == nullptr) {
+                return;
+            }
+            if (!singleStepper->Step()) {
+                singleStepper = nullptr;
+                return;
+            }
+            if (IsTracing() != TRACE) {
+                return;  // The debugger changed the debugging flags.
+            }
         }
     }
 }
 
+/// Run user instructions straight up to the next pending interrupt.
+///
+/// Calling `OneTick` after each instruction does nothing but advance the
+/// clock until an interrupt becomes due, so instead the instructions before
+/// that point are run back to back and their ticks are accounted for at
+/// once.  The sequence of simulated times, and the order in which
+/// interrupts fire, are the same as in the loop in `Run`.
+///
+/// If an instruction raises an exception, the ticks of the instructions
+/// before it are accounted for, and then it is handled exactly as in `Run`.
+///
+/// Return false if an interrupt is due after the very next instruction,
+/// in which case nothing is run.
+///
+/// * `limit` is the maximum number of instructions to run.
+template <bool TLB>
+bool
+Machine::RunBatch(unsigned long limit)
+{
+    unsigned long horizon = interrupt->UserTicksBeforeDue();
+    if (horizon == 0) {
+        return false;
+    }
+    if (limit > horizon) {
+        limit = horizon;
+    }
+
+    const Instruction *instr;
+    unsigned long done = 0;
+
+    deferExceptions = true;
+    while (done < limit
+           && FetchInstruction<false, TLB>(&instr)
+           && ExecInstruction<false, TLB>(instr)) {
+        done++;
+    }
+    deferExceptions = false;
+
+    interrupt->AdvanceUserTicks(done);
+    if (done < limit) {
+        DispatchException(deferredException);
+        interrupt->OneTick();
+    }
+    return true;
+}
+
 /// Simulate effects of a delayed load.
 ///
 /// NOTE -- `RaiseException`/`CheckInterrupts` must also call `DelayedLoad`,
@@ -59,26 +159,33 @@ Machine::DelayedLoad(unsigned nextReg, int nextValue)
     registers[0] = 0;  // And always make sure R0 stays zero.
 }
 
+/// Fetch the instruction at the current program counter.
+///
+/// Decoding is cached by the MMU, so that the same instruction is only
+/// decoded again once the memory it was read from changes.
+template <bool TRACE, bool TLB>
 bool
-Machine::FetchInstruction(Instruction *instr)
+Machine::FetchInstruction(const Instruction **instr)
 {
     ASSERT(instr != nullptr);
 
-    int raw;
-    if (!ReadMem(registers[PC_REG], 4, &raw)) {
+    ExceptionType e = mmu.FetchInstruction<TRACE, TLB>(registers[PC_REG],
+                                                       instr);
+    stats->numMemAccess++;
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, registers[PC_REG]);
         return false;  // Exception occurred.
     }
-    instr->value = raw;
-    instr->Decode();
 
-    if (debug.IsEnabled('m')) {
-        const struct OpString *str = &OP_STRINGS[instr->opCode];
+    if (TRACE && debug.IsEnabled('m')) {
+        const Instruction *in = *instr;
+        const struct OpString *str = &OP_STRINGS[in->opCode];
 
-        ASSERT(instr->opCode <= MAX_OPCODE);
+        ASSERT(in->opCode <= MAX_OPCODE);
         DEBUG('m', "At PC = 0x%X: ", registers[PC_REG]);
-        DEBUG_CONT('m', str->string, instr->RegFromType(str->args[0]),
-                        instr->RegFromType(str->args[1]),
-                        instr->RegFromType(str->args[2]));
+        DEBUG_CONT('m', str->string, in->RegFromType(str->args[0]),
+                        in->RegFromType(str->args[1]),
+                        in->RegFromType(str->args[2]));
         DEBUG_CONT('m', "\n");
     }
     return true;
@@ -157,11 +264,11 @@ Mult(int a, int b, bool signedArith, int *hiPtr, int *loPtr)
 /// Execute one instruction from a user-level program.
 ///
 /// If there is any kind of exception or interrupt, we invoke the exception
-/// handler, and when it returns, we return to `Run`, which will re-invoke us
-/// in a loop.  This allows us to re-start the instruction execution from the
-/// beginning, in case any of our state has changed.  On a syscall, the OS
-/// software must increment the PC so execution begins at the instruction
-/// immediately after the syscall.
+/// handler, and when it returns, we return false to `Run`, which will
+/// re-invoke us in a loop.  This allows us to re-start the instruction
+/// execution from the beginning, in case any of our state has changed.  On
+/// a syscall, the OS software must increment the PC so execution begins at
+/// the instruction immediately after the syscall.
 ///
 /// This routine is re-entrant, in that it can be called multiple times
 /// concurrently -- one for each thread executing user code.  We get
@@ -171,7 +278,8 @@ Mult(int a, int b, bool signedArith, int *hiPtr, int *loPtr)
 /// all data back to the machine registers and memory before leaving.  This
 /// allows the Nachos kernel to control our behavior by controlling the
 /// contents of memory, the translation table, and the register set.
-void
+template <bool TRACE, bool TLB>
+bool
 Machine::ExecInstruction(const Instruction *instr)
 {
     int nextLoadReg = 0;
@@ -192,7 +300,7 @@ Machine::ExecInstruction(const Instruction *instr)
             if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT)
                   && (registers[instr->rs] ^ sum) & SIGN_BIT) {
                 RaiseException(OVERFLOW_EXCEPTION, 0);
-                return;
+                return false;
             }
             registers[instr->rd] = sum;
             break;
@@ -202,7 +310,7 @@ Machine::ExecInstruction(const Instruction *instr)
             if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT)
                   && (instr->extra ^ sum) & SIGN_BIT) {
                 RaiseException(OVERFLOW_EXCEPTION, 0);
-                return;
+                return false;
             }
             registers[instr->rt] = sum;
             break;
@@ -307,8 +415,8 @@ Machine::ExecInstruction(const Instruction *instr)
         case OP_LB:
         case OP_LBU:
             tmp = registers[instr->rs] + instr->extra;
-            if (!ReadMem(tmp, 1, &value)) {
-                return;
+            if (!ReadMem<TRACE, TLB>(tmp, 1, &value)) {
+                return false;
             }
 
             if (value & 0x80 && instr->opCode == OP_LB) {
@@ -325,10 +433,10 @@ Machine::ExecInstruction(const Instruction *instr)
             tmp = registers[instr->rs] + instr->extra;
             if (tmp & 0x1) {
                 RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
-                return;
+                return false;
             }
-            if (!ReadMem(tmp, 2, &value)) {
-                return;
+            if (!ReadMem<TRACE, TLB>(tmp, 2, &value)) {
+                return false;
             }
 
             if (value & 0x8000 && instr->opCode == OP_LH) {
@@ -341,7 +449,10 @@ Machine::ExecInstruction(const Instruction *instr)
             break;
 
         case OP_LUI:
-            DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
+            if (TRACE) {
+                DEBUG('m', "Executing: LUI r%d,%d\n",
+                      instr->rt, instr->extra);
+            }
             registers[instr->rt] = instr->extra << 16;
             break;
 
@@ -349,10 +460,10 @@ Machine::ExecInstruction(const Instruction *instr)
             tmp = registers[instr->rs] + instr->extra;
             if (tmp & 0x3) {
                 RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
-                return;
+                return false;
             }
-            if (!ReadMem(tmp, 4, &value)) {
-                return;
+            if (!ReadMem<TRACE, TLB>(tmp, 4, &value)) {
+                return false;
             }
             nextLoadReg = instr->rt;
             nextLoadValue = value;
@@ -366,8 +477,8 @@ Machine::ExecInstruction(const Instruction *instr)
             // would fail (I think) if the other cases are ever exercised.
             ASSERT((tmp & 0x3) == 0);
 
-            if (!ReadMem(tmp, 4, &value)) {
-                return;
+            if (!ReadMem<TRACE, TLB>(tmp, 4, &value)) {
+                return false;
             }
             if (registers[LOAD_REG] == instr->rt) {
                 nextLoadValue = registers[LOAD_VALUE_REG];
@@ -399,8 +510,8 @@ Machine::ExecInstruction(const Instruction *instr)
             // would fail (I think) if the other cases are ever exercised.
             ASSERT((tmp & 0x3) == 0);
 
-            if (!ReadMem(tmp, 4, &value)) {
-                return;
+            if (!ReadMem<TRACE, TLB>(tmp, 4, &value)) {
+                return false;
             }
             if (registers[LOAD_REG] == instr->rt) {
                 nextLoadValue = registers[LOAD_VALUE_REG];
@@ -469,16 +580,16 @@ Machine::ExecInstruction(const Instruction *instr)
             break;
 
         case OP_SB:
-            if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
-                          1, registers[instr->rt])) {
-                return;
+            tmp = registers[instr->rs] + instr->extra;
+            if (!WriteMem<TRACE, TLB>(tmp, 1, registers[instr->rt])) {
+                return false;
             }
             break;
 
         case OP_SH:
-            if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
-                          2, registers[instr->rt])) {
-                return;
+            tmp = registers[instr->rs] + instr->extra;
+            if (!WriteMem<TRACE, TLB>(tmp, 2, registers[instr->rt])) {
+                return false;
             }
             break;
 
@@ -539,7 +650,7 @@ Machine::ExecInstruction(const Instruction *instr)
             if ((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT
                   && (registers[instr->rs] ^ diff) & SIGN_BIT) {
                 RaiseException(OVERFLOW_EXCEPTION, 0);
-                return;
+                return false;
             }
             registers[instr->rd] = diff;
             break;
@@ -550,9 +661,9 @@ Machine::ExecInstruction(const Instruction *instr)
             break;
 
         case OP_SW:
-            if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
-                          4, registers[instr->rt])) {
-                return;
+            tmp = registers[instr->rs] + instr->extra;
+            if (!WriteMem<TRACE, TLB>(tmp, 4, registers[instr->rt])) {
+                return false;
             }
             break;
 
@@ -563,8 +674,8 @@ Machine::ExecInstruction(const Instruction *instr)
             // the other cases are ever exercised.
             ASSERT((tmp & 0x3) == 0);
 
-            if (!ReadMem(tmp & ~0x3, 4, &value)) {
-                return;
+            if (!ReadMem<TRACE, TLB>(tmp & ~0x3, 4, &value)) {
+                return false;
             }
             switch (tmp & 0x3) {
                 case 0:
@@ -583,8 +694,8 @@ Machine::ExecInstruction(const Instruction *instr)
                             | (registers[instr->rt] >> 24 & 0xFF);
                     break;
             }
-            if (!WriteMem(tmp & ~0x3, 4, value)) {
-                return;
+            if (!WriteMem<TRACE, TLB>(tmp & ~0x3, 4, value)) {
+                return false;
             }
             break;
 
@@ -595,8 +706,8 @@ Machine::ExecInstruction(const Instruction *instr)
             // the other cases are ever exercised.
             ASSERT((tmp & 0x3) == 0);
 
-            if (!ReadMem(tmp & ~0x3, 4, &value)) {
-                return;
+            if (!ReadMem<TRACE, TLB>(tmp & ~0x3, 4, &value)) {
+                return false;
             }
             switch (tmp & 0x3) {
                 case 0:
@@ -614,14 +725,14 @@ Machine::ExecInstruction(const Instruction *instr)
                     value = registers[instr->rt];
                     break;
             }
-            if (!WriteMem(tmp & ~0x3, 4, value)) {
-                return;
+            if (!WriteMem<TRACE, TLB>(tmp & ~0x3, 4, value)) {
+                return false;
             }
             break;
 
         case OP_SYSCALL:
             RaiseException(SYSCALL_EXCEPTION, 0);
-            return;
+            return false;
 
         case OP_XOR:
             registers[instr->rd] = registers[instr->rs]
@@ -636,7 +747,7 @@ Machine::ExecInstruction(const Instruction *instr)
         case OP_RES:
         case OP_UNIMP:
             RaiseException(ILLEGAL_INSTR_EXCEPTION, 0);
-            return;
+            return false;
 
         default:
             ASSERT(false);
@@ -652,4 +763,30 @@ Machine::ExecInstruction(const Instruction *instr)
       // For debugging, in case we are jumping into lala-land.
     registers[PC_REG] = registers[NEXT_PC_REG];
     registers[NEXT_PC_REG] = pcAfter;
+    return true;
 }
+
+/// Execute one instruction without letting the kernel run.
+///
+/// Any exception is left for the caller to dispatch.  Nothing happens in
+/// between, since every exception makes `ExecInstruction` return right
+/// away.
+template <bool TLB>
+bool
+Machine::ExecInstructionDeferred(const Instruction *instr, ExceptionType *et)
+{
+    ASSERT(et != nullptr);
+
+    deferExceptions = true;
+    bool ok = ExecInstruction<false, TLB>(instr);
+    deferExceptions = false;
+    if (!ok) {
+        *et = deferredException;
+    }
+    return ok;
+}
+
+template bool Machine::ExecInstructionDeferred<false>(const Instruction *,
+                                                      ExceptionType *);
+template bool Machine::ExecInstructionDeferred<true>(const Instruction *,
+                                                     ExceptionType *);
@@ -29,36 +29,85 @@
 
 
 #include "mmu.hh"
+#include "decode_cache.hh"
 #include "endianness.hh"
 #include "threads/system.hh"
 
+#include <limits.h>
 #include <stdio.h>
 
 
-MMU::MMU()
+thread_local unsigned PAGE_SIZE      = DEFAULT_PAGE_SIZE;
+thread_local unsigned NUM_PHYS_PAGES = DEFAULT_NUM_PHYS_PAGES;
+thread_local unsigned MEMORY_SIZE    = DEFAULT_NUM_PHYS_PAGES
+                                       * DEFAULT_PAGE_SIZE;
+thread_local unsigned TLB_SIZE       = DEFAULT_TLB_SIZE;
+
+bool
+SetMemoryGeometry(unsigned pageSize, unsigned numPhysPages, unsigned tlbSize)
 {
-    mainMemory = new char [MEMORY_SIZE];
-    for (unsigned i = 0; i < MEMORY_SIZE; i++) {
-        mainMemory[i] = 0;
+    if (pageSize < 4 || (pageSize & (pageSize - 1)) != 0
+          || numPhysPages < MIN_NUM_PHYS_PAGES
+          || (unsigned long long) numPhysPages * pageSize > UINT_MAX
+          || tlbSize == 0) {
+        return false;
     }
+    PAGE_SIZE      = pageSize;
+    NUM_PHYS_PAGES = numPhysPages;
+    MEMORY_SIZE    = numPhysPages * pageSize;
+    TLB_SIZE       = tlbSize;
+    return true;
+}
+
+MMU::MMU()
+{
+    mainMemory = new char [MEMORY_SIZE]();  // Zeroed.
+    decodeCache = new DecodeCache(mainMemory, NUM_PHYS_PAGES, PAGE_SIZE);
 
 #ifdef USE_TLB
     tlb = new TranslationEntry[TLB_SIZE];
+    tlbLastUse = new unsigned long [TLB_SIZE];
+    tlbOrigin = new TranslationEntry * [TLB_SIZE];
+    tlbPreloaded = new bool [TLB_SIZE];
     for (unsigned i = 0; i < TLB_SIZE; i++) {
         tlb[i].valid = false;
+        tlbLastUse[i] = 0;
+        tlbOrigin[i] = nullptr;
+        tlbPreloaded[i] = false;
     }
+    currentAsid = 0;
     pageTable = nullptr;
 #else  // Use linear page table.
     tlb = nullptr;
+    tlbLastUse = nullptr;
+    tlbOrigin = nullptr;
+    tlbPreloaded = nullptr;
+    currentAsid = 0;
     pageTable = nullptr;
 #endif
+    walkPageTable = false;
+
+    for (unsigned i = 0; i < HOST_CACHE_SIZE; i++) {
+        hostCache[false][i].epoch = 0;
+        hostCache[true][i].epoch  = 0;
+    }
+    hostEpoch = 1;
+
+    pageShift = 0;
+    while (1U << pageShift != PAGE_SIZE) {
+        pageShift++;
+    }
 }
 
 MMU::~MMU()
 {
+    delete decodeCache;
     delete [] mainMemory;
     if (tlb != nullptr) {
         delete [] tlb;
+        delete [] tlbLastUse;
+        delete [] tlbOrigin;
+        delete [] tlbPreloaded;
     }
 }
 
@@ -66,11 +115,13 @@ void
 MMU::PrintTLB() const
 {
 #ifdef USE_TLB
-    printf("TLB content (%u entries):\n", TLB_SIZE);
+    printf("TLB content (%u entries, current ASID %u):\n",
+           TLB_SIZE, currentAsid);
     for (unsigned i = 0; i < TLB_SIZE; i++) {
         const TranslationEntry *e = &tlb[i];
-        printf("(%u) valid: %d, virt: %d, frame: %d, flags: %s%s%s\n",
-               i, e->valid, e->virtualPage, e->physicalPage,
+        printf("(%u) valid: %d, asid: %u, virt: %d, frame: %d,"
+               " flags: %s%s%s\n",
+               i, e->valid, e->asid, e->virtualPage, e->physicalPage,
                (e->readOnly) ? "readonly " : "",
                (e->use)      ? "use " : "",
                (e->dirty)    ? "dirty" : "");
@@ -80,6 +131,41 @@ MMU::PrintTLB() const
 #endif
 }
 
+void
+MMU::FlushHostCache()
+{
+    hostEpoch++;
+}
+
+template <bool TLB>
+inline char *
+MMU::LookupHostCache(unsigned virtAddr, unsigned size, bool writing)
+{
+    if ((size == 4 && virtAddr & 0x3) || (size == 2 && virtAddr & 0x1)) {
+        return nullptr;  // Let `Translate` raise the alignment error.
+    }
+
+    unsigned vpn = virtAddr >> pageShift;
+    HostTranslation *h = &hostCache[writing][vpn % HOST_CACHE_SIZE];
+    if (h->epoch != hostEpoch || h->vpn != vpn) {
+        return nullptr;
+    }
+
+#ifdef PRPOLICY_LRU
+    if (TLB) {
+        coreMap->UpdateReferenceBits(h->entry->physicalPage);
+    }
+#endif
+    if (TLB) {
+        *h->lastUse = ++stats->numTlbHits;
+    }
+    h->entry->use = true;
+    if (writing) {
+        h->entry->dirty = true;
+    }
+    return h->page + (virtAddr & ((1U << pageShift) - 1));
+}
+
 /// Read `size` (1, 2, or 4) bytes of virtual memory at `addr` into
 /// the location pointed to by `value`.
 ///
@@ -91,31 +177,60 @@ MMU::PrintTLB() const
 /// * `value` is the place to write the result.
 ExceptionType
 MMU::ReadMem(unsigned addr, unsigned size, int *value)
+{
+    return tlb != nullptr ? ReadMem<true, true>(addr, size, value)
+                          : ReadMem<true, false>(addr, size, value);
+}
+
+ExceptionType
+MMU::TranslateAccess(unsigned addr, unsigned size, bool writing,
+                     unsigned *physAddr)
+{
+    ASSERT(physAddr != nullptr);
+
+    DEBUG('a', "Translating VA 0x%X, size %u, for %s\n",
+          addr, size, writing ? "writing" : "reading");
+    if (tlb != nullptr) {
+        return Translate<true, true>(addr, physAddr, size, writing);
+    }
+    return Translate<true, false>(addr, physAddr, size, writing);
+}
+
+template <bool TRACE, bool TLB>
+ExceptionType
+MMU::ReadMem(unsigned addr, unsigned size, int *value)
 {
     ASSERT(value != nullptr);
 
-    DEBUG('a', "Reading VA 0x%X, size %u\n", addr, size);
+    if (TRACE) {
+        DEBUG('a', "Reading VA 0x%X, size %u\n", addr, size);
+    }
 
-    unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, false);
-    if (e != NO_EXCEPTION) {
-        return e;
+    char *host = TRACE ? nullptr : LookupHostCache<TLB>(addr, size, false);
+    if (host == nullptr) {
+        unsigned physicalAddress;
+        ExceptionType e = Translate<TRACE, TLB>(addr, &physicalAddress,
+                                                size, false);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+        host = &mainMemory[physicalAddress];
     }
 
     int data;
     switch (size) {
         case 1:
-            data = mainMemory[physicalAddress];
+            data = *host;
             *value = data;
             break;
 
         case 2:
-            data = *(unsigned short *) &mainMemory[physicalAddress];
+            data = *(unsigned short *) host;
             *value = ShortToHost(data);
             break;
 
         case 4:
-            data = *(unsigned *) &mainMemory[physicalAddress];
+            data = *(unsigned *) host;
             *value = WordToHost(data);
             break;
 
@@ -123,7 +238,9 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
             ASSERT(false);
     }
 
-    DEBUG('a', "\tValue read: %8.8X\n", *value);
+    if (TRACE) {
+        DEBUG('a', "\tValue read: %8.8X\n", *value);
+    }
     return NO_EXCEPTION;
 }
 
@@ -139,84 +256,227 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
 ExceptionType
 MMU::WriteMem(unsigned addr, unsigned size, int value)
 {
-    DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n", addr, size, value);
+    return tlb != nullptr ? WriteMem<true, true>(addr, size, value)
+                          : WriteMem<true, false>(addr, size, value);
+}
 
-    unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, true);
-    if (e != NO_EXCEPTION) {
-        return e;
+template <bool TRACE, bool TLB>
+ExceptionType
+MMU::WriteMem(unsigned addr, unsigned size, int value)
+{
+    if (TRACE) {
+        DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n",
+              addr, size, value);
+    }
+
+    char *host = TRACE ? nullptr : LookupHostCache<TLB>(addr, size, true);
+    if (host == nullptr) {
+        unsigned physicalAddress;
+        ExceptionType e = Translate<TRACE, TLB>(addr, &physicalAddress,
+                                                size, true);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+        host = &mainMemory[physicalAddress];
     }
 
     switch (size) {
         case 1:
-            mainMemory[physicalAddress]
-              = (unsigned char) (value & 0xFF);
+            *host = (unsigned char) (value & 0xFF);
             break;
 
         case 2:
-            *(unsigned short *) &mainMemory[physicalAddress]
+            *(unsigned short *) host
               = ShortToMachine((unsigned short) (value & 0xFFFF));
             break;
 
         case 4:
-            *(unsigned *) &mainMemory[physicalAddress]
-              = WordToMachine((unsigned) value);
+            *(unsigned *) host = WordToMachine((unsigned) value);
             break;
 
         default:
             ASSERT(false);
     }
 
+    // Anything decoded from the modified word is now stale.
+    decodeCache->NoteWrite((unsigned) (host - mainMemory) & ~0x3);
+
     return NO_EXCEPTION;
 }
 
+/// Fetch the instruction at `addr` into `*instr`.
+///
+/// Returns the exception that prevented the fetch, if any.
+///
+/// * `addr` is the virtual address of the instruction.
+/// * `instr` is where to store a pointer to the decoded instruction.
+template <bool TRACE, bool TLB>
+ExceptionType
+MMU::FetchInstruction(unsigned addr, const Instruction **instr)
+{
+    ASSERT(instr != nullptr);
+
+    if (TRACE) {
+        DEBUG('a', "Fetching VA 0x%X\n", addr);
+    }
+
+    unsigned physicalAddress;
+    ExceptionType e;
+    if (TRACE) {
+        e = Translate<TRACE, TLB>(addr, &physicalAddress, 4, false);
+    } else {
+        e = TranslateFetch<TLB>(addr, &physicalAddress);
+    }
+    if (e != NO_EXCEPTION) {
+        return e;
+    }
+
+    *instr = decodeCache->Lookup(physicalAddress);
+    return NO_EXCEPTION;
+}
+
+template <bool TLB>
+ExceptionType
+MMU::TranslateFetch(unsigned addr, unsigned *physAddr)
+{
+    ASSERT(physAddr != nullptr);
+
+    char *host = LookupHostCache<TLB>(addr, 4, false);
+    if (host != nullptr) {
+        *physAddr = (unsigned) (host - mainMemory);
+        return NO_EXCEPTION;
+    }
+    return Translate<false, TLB>(addr, physAddr, 4, false);
+}
+
+DecodeCache *
+MMU::GetDecodeCache()
+{
+    return decodeCache;
+}
+
+void
+MMU::InvalidateFrame(unsigned frame)
+{
+    ASSERT(frame < NUM_PHYS_PAGES);
+    decodeCache->InvalidateFrame(frame);
+
+    // The frame is being handed over, so its translations are stale too.
+    FlushHostCache();
+}
+
+template <bool TRACE, bool TLB>
 ExceptionType
 MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
 {
     ASSERT(entry != nullptr);
 
-    if (tlb == nullptr) {
-        // Use a page table; `vpn` is an index in the table.
-        if (vpn >= pageTableSize) {
-            DEBUG_CONT('a', "virtual page # %u too large for"
-                            " page table size %u!\n",
-                       vpn, pageTableSize);
+    if (!TLB) {
+        // Use a page table.
+        if (vpn >= pageTable->GetNumPages()) {
+            if (TRACE) {
+                DEBUG_CONT('a', "virtual page # %u too large for"
+                                " page table size %u!\n",
+                           vpn, pageTable->GetNumPages());
+            }
             return ADDRESS_ERROR_EXCEPTION;
-        } else if (!pageTable[vpn].valid) {
-            DEBUG_CONT('a', "virtual page # %u too large for"
-                            " page table size %u!\n",
-                       vpn, pageTableSize);
+        }
+        TranslationEntry *e = pageTable->Find(vpn);
+        if (e == nullptr || !e->valid) {
+            if (TRACE) {
+                DEBUG_CONT('a', "virtual page # %u not valid!\n", vpn);
+            }
             return PAGE_FAULT_EXCEPTION;
         }
-        *entry = &pageTable[vpn];
+        *entry = e;
         return NO_EXCEPTION;
     } else {
         // Use the TLB.
-        if(currentThread->space->pageTable[vpn].valid){
-            unsigned i;
-            for (i = 0; i < TLB_SIZE; i++) {
-                if (tlb[i].valid && tlb[i].virtualPage == vpn) {
-                    *entry = &tlb[i];  // FOUND!
+        for (unsigned i = 0; i < TLB_SIZE; i++) {
+            if (tlb[i].valid && tlb[i].virtualPage == vpn
+                  && tlb[i].asid == currentAsid) {
+                *entry = &tlb[i];  // FOUND!
+                tlbLastUse[i] = ++stats->numTlbHits;
+                if (tlbPreloaded[i]) {
+                    tlbPreloaded[i] = false;
+                    stats->numTlbPreloadHits++;
+                }
 
-                    // Ejercicio 5b plancha 4
-                    #ifdef PRPOLICY_LRU
-                      coreMap->UpdateReferenceBits(tlb[i].physicalPage);
-                    #endif
+                // Ejercicio 5b plancha 4
+                #ifdef PRPOLICY_LRU
+                  coreMap->UpdateReferenceBits(tlb[i].physicalPage);
+                #endif
 
+                if (TRACE) {
                     DEBUG('T', "Hit! vadd: %d tlbindex: %u. \n", vpn, i);
-                    return NO_EXCEPTION;
                 }
+                return NO_EXCEPTION;
             }
         }
         // Not found.
-        DEBUG_CONT('a', "Virtual page not found in TLB\n");
-        DEBUG('T', "Miss!\n");
+        stats->numTlbMisses++;
+        if (TRACE) {
+            DEBUG_CONT('a', "Virtual page not found in TLB\n");
+        }
+        if (TRACE) {
+            DEBUG('T', "Miss!\n");
+        }
         return PAGE_FAULT_EXCEPTION;  // Really, this is a TLB fault, the
                                       // page may be in memory, but not in
                                       // the TLB.
     }
 }
 
+template <bool TRACE>
+TranslationEntry *
+MMU::WalkPageTable(unsigned vpn)
+{
+    ASSERT(tlb != nullptr);
+
+    if (pageTable == nullptr || vpn >= pageTable->GetNumPages()) {
+        return nullptr;
+    }
+    TranslationEntry *pte = pageTable->Find(vpn);
+    if (pte == nullptr || !pte->valid) {
+        return nullptr;
+    }
+
+    // The hardware takes a free entry if there is one, otherwise the one
+    // used least recently, whatever address space it belongs to.
+    unsigned victim = 0;
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        if (!tlb[i].valid) {
+            victim = i;
+            break;
+        }
+        if (tlbLastUse[i] < tlbLastUse[victim]) {
+            victim = i;
+        }
+    }
+
+    TranslationEntry *old    = &tlb[victim];
+    TranslationEntry *origin = tlbOrigin[victim];
+    if (old->valid && origin != nullptr && origin->valid
+          && origin->physicalPage == old->physicalPage) {
+        origin->use   = origin->use   || old->use;
+        origin->dirty = origin->dirty || old->dirty;
+    }
+
+    if (TRACE) {
+        DEBUG('T', "Walk! vpn: %u tlbindex: %u.\n", vpn, victim);
+    }
+    tlb[victim]        = *pte;
+    tlb[victim].asid   = currentAsid;
+    tlbOrigin[victim]  = pte;
+    tlbLastUse[victim] = stats->numTlbHits;
+    tlbPreloaded[victim] = false;
+    stats->numTlbWalks++;
+
+    // Host cache entries may point to the replaced entry.
+    FlushHostCache();
+    return &tlb[victim];
+}
+
 /// Translate a virtual address into a physical address, using
 /// either a page table or a TLB.
 ///
@@ -229,37 +489,52 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
 /// * `physAddr" is the place to store the physical address.
 /// * `size" is the amount of memory being read or written.
 /// * `writing` -- if true, check the “read-only” bit in the TLB.
+template <bool TRACE, bool TLB>
 ExceptionType
 MMU::Translate(unsigned virtAddr, unsigned *physAddr,
                unsigned size, bool writing)
 {
     ASSERT(physAddr != nullptr);
-    // We must have either a TLB or a page table, but not both!
-    ASSERT((tlb == nullptr) != (pageTable == nullptr));
+    // We must have either a TLB or a page table; both only if the hardware
+    // refills the TLB from the page table.
+    ASSERT(tlb != nullptr || pageTable != nullptr);
+    ASSERT(TLB == (tlb != nullptr));
 
-    DEBUG('a', "\tTranslate: ");
+    if (TRACE) {
+        DEBUG('a', "\tTranslate: ");
+    }
 
     // Check for alignment errors.
     if ((size == 4 && virtAddr & 0x3) || (size == 2 && virtAddr & 0x1)) {
-        DEBUG_CONT('a', "alignment problem at %u, size %u!\n",
-                   virtAddr, size);
+        if (TRACE) {
+            DEBUG_CONT('a', "alignment problem at %u, size %u!\n",
+                       virtAddr, size);
+        }
         return ADDRESS_ERROR_EXCEPTION;
     }
 
     // Calculate the virtual page number, and offset within the page,
     // from the virtual address.
-    unsigned vpn    = (unsigned) virtAddr / PAGE_SIZE;
-    unsigned offset = (unsigned) virtAddr % PAGE_SIZE;
+    unsigned vpn    = (unsigned) virtAddr >> pageShift;
+    unsigned offset = (unsigned) virtAddr & ((1U << pageShift) - 1);
 
     TranslationEntry *entry;
-    ExceptionType exception = RetrievePageEntry(vpn, &entry);
+    ExceptionType exception = RetrievePageEntry<TRACE, TLB>(vpn, &entry);
+    if (TLB && exception == PAGE_FAULT_EXCEPTION && walkPageTable) {
+        entry = WalkPageTable<TRACE>(vpn);
+        if (entry != nullptr) {
+            exception = NO_EXCEPTION;
+        }
+    }
     if (exception != NO_EXCEPTION) {
         return exception;
     }
 
     if (entry->readOnly && writing) {  // Trying to write to a read-only
                                        // page.
-        DEBUG_CONT('a', "%u mapped read-only!\n", virtAddr);
+        if (TRACE) {
+            DEBUG_CONT('a', "%u mapped read-only!\n", virtAddr);
+        }
         return READ_ONLY_EXCEPTION;
     }
 
@@ -268,7 +543,9 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
     // If the `pageFrame` is too big, there is something really wrong!  An
     // invalid translation was loaded into the page table or TLB.
     if (pageFrame >= NUM_PHYS_PAGES) {
-        DEBUG_CONT('a', "frame %u > %u!\n", pageFrame, NUM_PHYS_PAGES);
+        if (TRACE) {
+            DEBUG_CONT('a', "frame %u > %u!\n", pageFrame, NUM_PHYS_PAGES);
+        }
         return BUS_ERROR_EXCEPTION;
     }
 
@@ -280,6 +557,39 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
 
     *physAddr = pageFrame * PAGE_SIZE + offset;
     ASSERT(*physAddr >= 0 && *physAddr + size <= MEMORY_SIZE);
-    DEBUG_CONT('a', "physical address 0x%X\n", *physAddr);
+
+    // Translations made while debugging messages are enabled are not
+    // cached, since cache hits print nothing.
+    if (!TRACE) {
+        HostTranslation *h = &hostCache[writing][vpn % HOST_CACHE_SIZE];
+        h->epoch   = hostEpoch;
+        h->vpn     = vpn;
+        h->page    = &mainMemory[pageFrame * PAGE_SIZE];
+        h->entry   = entry;
+        h->lastUse = TLB ? &tlbLastUse[entry - tlb] : nullptr;
+    }
+    if (TRACE) {
+        DEBUG_CONT('a', "physical address 0x%X\n", *physAddr);
+    }
     return NO_EXCEPTION;
 }
+
+
+template ExceptionType MMU::ReadMem<false, false>(unsigned, unsigned, int *);
+template ExceptionType MMU::ReadMem<false, true>(unsigned, unsigned, int *);
+template ExceptionType MMU::ReadMem<true, false>(unsigned, unsigned, int *);
+template ExceptionType MMU::ReadMem<true, true>(unsigned, unsigned, int *);
+template ExceptionType MMU::WriteMem<false, false>(unsigned, unsigned, int);
+template ExceptionType MMU::WriteMem<false, true>(unsigned, unsigned, int);
+template ExceptionType MMU::WriteMem<true, false>(unsigned, unsigned, int);
+template ExceptionType MMU::WriteMem<true, true>(unsigned, unsigned, int);
+template ExceptionType MMU::FetchInstruction<false, false>(unsigned,
+                                                           const Instruction **);
+template ExceptionType MMU::FetchInstruction<false, true>(unsigned,
+                                                          const Instruction **);
+template ExceptionType MMU::FetchInstruction<true, false>(unsigned,
+                                                          const Instruction **);
+template ExceptionType MMU::FetchInstruction<true, true>(unsigned,
+                                                         const Instruction **);
+template ExceptionType MMU::TranslateFetch<false>(unsigned, unsigned *);
+template ExceptionType MMU::TranslateFetch<true>(unsigned, unsigned *);
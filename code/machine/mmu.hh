@@ -11,21 +11,65 @@
 
 #include "exception_type.hh"
 #include "disk.hh"
+#include "page_table.hh"
 #include "translation_entry.hh"
 
 
+class DecodeCache;
+class Instruction;
+
+
 /// Definitions related to the size, and format of user memory.
+///
+/// They are parameters of the simulated machine, fixed before it is created
+/// (see `SetMemoryGeometry`) and never changed afterwards.  Each kernel
+/// instance has its own.
+
+/// Set the page size equal to the disk sector size, for simplicity.
+const unsigned DEFAULT_PAGE_SIZE = SECTOR_SIZE;
+const unsigned DEFAULT_NUM_PHYS_PAGES = 32;
+
+/// Fewest frames the main memory may have: an instruction may need its own
+/// page and the one it loads from or stores to, both at once.  Loading on
+/// demand also keeps a frame of zeros that is never handed out.
+#ifdef DEMAND_LOADING
+const unsigned MIN_NUM_PHYS_PAGES = 3;
+#else
+const unsigned MIN_NUM_PHYS_PAGES = 2;
+#endif
 
-const unsigned PAGE_SIZE = SECTOR_SIZE;  ///< Set the page size equal to the
-                                         ///< disk sector size, for
-                                         ///< simplicity.
-const unsigned NUM_PHYS_PAGES = 32;
-const unsigned MEMORY_SIZE = NUM_PHYS_PAGES * PAGE_SIZE;
+/// Default number of entries in the TLB, if one is present.
+///
+/// If there is a TLB, it will be small compared to page tables.  It can be
+/// changed at build time by defining `TLB_ENTRIES` (for instance,
+/// `-DTLB_ENTRIES=16` in the `DEFINES` of a `Makefile`).
+#ifndef TLB_ENTRIES
+#define TLB_ENTRIES 4
+#endif
+const unsigned DEFAULT_TLB_SIZE = TLB_ENTRIES;
 
-/// Number of entries in the TLB, if one is present.
+extern thread_local unsigned PAGE_SIZE;       ///< A power of two.
+extern thread_local unsigned NUM_PHYS_PAGES;
+extern thread_local unsigned MEMORY_SIZE;     ///< In bytes.
+extern thread_local unsigned TLB_SIZE;
+
+/// Set the size of pages (`pageSize` bytes), of the main memory
+/// (`numPhysPages` frames) and of the TLB (`tlbSize` entries).
 ///
-/// If there is a TLB, it will be small compared to page tables.
-const unsigned TLB_SIZE = 4;
+/// Return false, leaving them unchanged, if they are not valid: the page
+/// size must be a power of two, at least the size of a word; the memory
+/// must hold at least `MIN_NUM_PHYS_PAGES` pages and less than 4 GiB; the
+/// TLB must have at least an entry.
+bool SetMemoryGeometry(unsigned pageSize, unsigned numPhysPages,
+                       unsigned tlbSize);
+
+/// Number of address space identifiers that TLB entries can be tagged
+/// with.
+const unsigned NUM_ASIDS = 64;
+
+/// Number of pages remembered by the host translation cache, for each kind
+/// of access.  Must be a power of two.
+const unsigned HOST_CACHE_SIZE = 64;
 
 
 /// This class simulates an MMU (memory management unit) that can use either
@@ -45,6 +89,64 @@ public:
 
     ExceptionType WriteMem(unsigned addr, unsigned size, int value);
 
+    /// Variants of the above for a fixed configuration, used by the
+    /// simulator while running user code:
+    ///
+    /// * `TRACE` -- if false, no debugging message is printed, so the
+    ///   caller must make sure none is enabled;
+    /// * `TLB` -- if true, translate through `tlb`, otherwise through
+    ///   `pageTable`; it must match the one that is in use.
+
+    template <bool TRACE, bool TLB>
+    ExceptionType ReadMem(unsigned addr, unsigned size, int *value);
+
+    template <bool TRACE, bool TLB>
+    ExceptionType WriteMem(unsigned addr, unsigned size, int value);
+
+    /// Fetch the instruction at virtual address `addr`, already decoded.
+    ///
+    /// Translation is done exactly as for a 4-byte `ReadMem`, but the
+    /// decoding step is served from `decodeCache` whenever possible.
+    template <bool TRACE, bool TLB>
+    ExceptionType FetchInstruction(unsigned addr, const Instruction **instr);
+
+    /// Translate the address `addr` of an instruction exactly as
+    /// `FetchInstruction` does, without printing debugging messages, but
+    /// store its physical address in `*physAddr` instead of decoding it.
+    template <bool TLB>
+    ExceptionType TranslateFetch(unsigned addr, unsigned *physAddr);
+
+    /// Translate the virtual address `addr` as a `size`-byte `ReadMem` or
+    /// `WriteMem` (according to `writing`) would, setting the use and dirty
+    /// bits, and store where it is in `mainMemory` in `*physAddr`, without
+    /// accessing it.
+    ///
+    /// Meant for kernel routines that work on user memory a page at a time;
+    /// the caller must tell `decodeCache` about what it writes.
+    ExceptionType TranslateAccess(unsigned addr, unsigned size, bool writing,
+                                  unsigned *physAddr);
+
+    /// Forget every translation remembered by the host translation cache.
+    ///
+    /// Translations made while running user code are cached by virtual
+    /// page and kind of access (read or write), straight as pointers into
+    /// `mainMemory`.  The cache knows nothing about address spaces nor
+    /// about the kernel, so this must be called whenever the address space
+    /// changes, and whenever the kernel modifies a translation entry that
+    /// may be in use (including the validity of the page table entry
+    /// behind a TLB entry).  Entering the kernel through an exception
+    /// already calls it on return.
+    void FlushHostCache();
+
+    /// Return the cache that `FetchInstruction` decodes instructions into.
+    DecodeCache *GetDecodeCache();
+
+    /// Tell the MMU that the contents of physical frame `frame` were
+    /// replaced directly in `mainMemory`, so that nothing decoded from its
+    /// previous contents is executed.  The host translation cache is
+    /// flushed as well.
+    void InvalidateFrame(unsigned frame);
+
     void PrintTLB() const;
 
     /// Data structures -- all of these are accessible to Nachos kernel code.
@@ -64,7 +166,7 @@ public:
     /// * a software-loaded translation lookaside buffer (tlb) -- a cache of
     ///   mappings of virtual page #'s to physical page #'s.
     ///
-    /// If `tlb` is null, the linear page table is used.
+    /// If `tlb` is null, the page table is used.
     /// If `tlb` is non-null, the Nachos kernel is responsible for managing
     /// the contents of the TLB.  But the kernel can use any data structure
     /// it wants (eg, segmented paging) for handling TLB cache misses.
@@ -79,20 +181,91 @@ public:
     TranslationEntry *tlb;  ///< This pointer should be considered
                             ///< “read-only” to Nachos kernel code.
 
-    TranslationEntry *pageTable;
-    unsigned pageTableSize;
+    /// For every entry of `tlb`, the value of `stats->numTlbHits` right
+    /// after its last hit; so the entry used least recently has the lowest
+    /// one.  Read-only to Nachos kernel code, which may use it to choose
+    /// the entry to replace.
+    unsigned long *tlbLastUse;
+
+    /// Identifier of the running address space, less than `NUM_ASIDS`.
+    ///
+    /// Only the entries of `tlb` tagged with it are used, so the TLB can
+    /// hold translations of several address spaces at once.  The host
+    /// translation cache must be flushed whenever it changes.
+    unsigned currentAsid;
+
+    /// If true, a TLB miss on a page that is valid in `pageTable` is
+    /// refilled by the hardware, which walks the page table itself, instead
+    /// of raising `PAGE_FAULT_EXCEPTION`.  Only pages that are not present
+    /// reach the kernel.  `pageTable` must then point to the page table of
+    /// the running address space, even though there is a TLB.
+    bool walkPageTable;
+
+    /// For every entry of `tlb`, the page table entry it was loaded from,
+    /// or null if unknown.  When the walker replaces an entry, it copies
+    /// the `use` and `dirty` bits back there.
+    TranslationEntry **tlbOrigin;
+
+    /// For every entry of `tlb`, whether the kernel loaded it ahead of use
+    /// and it has not been hit since.  Loading it flushes the host
+    /// translation cache, so its first hit is always looked up here, and
+    /// counted in `stats->numTlbPreloadHits`.
+    bool *tlbPreloaded;
+
+    PageTable *pageTable;
 
 private:
 
+    /// Translated code looks up `hostCache` by itself.
+    friend class Jit;
+
+    /// Decoded instructions, indexed by physical frame.
+    DecodeCache *decodeCache;
+
+    /// A translation remembered by the host translation cache.
+    struct HostTranslation {
+        unsigned long epoch;      ///< Valid only if equal to `hostEpoch`.
+        unsigned vpn;
+        char *page;               ///< Start of the frame in `mainMemory`.
+        TranslationEntry *entry;  ///< Where to set the use and dirty bits.
+        unsigned long *lastUse;   ///< Where to record a TLB hit, if `entry`
+                                  ///< is in `tlb`.
+    };
+
+    /// Host translation cache, direct mapped by virtual page number; one
+    /// table for reads and one for writes.
+    HostTranslation hostCache[2][HOST_CACHE_SIZE];
+
+    /// Incremented on every flush, which invalidates every entry at once.
+    unsigned long hostEpoch;
+
+    /// `PAGE_SIZE` is `1 << pageShift`; shifting is cheaper than dividing
+    /// on every access.
+    unsigned pageShift;
+
+    /// Return where the `size` bytes at `virtAddr` are in `mainMemory` if
+    /// the translation is cached, updating the translation entry exactly as
+    /// `Translate` would; otherwise return null.
+    template <bool TLB>
+    char *LookupHostCache(unsigned virtAddr, unsigned size, bool writing);
+
     /// Retrieve a page entry either from a page table or the TLB.
+    template <bool TRACE, bool TLB>
     ExceptionType RetrievePageEntry(unsigned vpn,
                                     TranslationEntry **entry) const;
 
+    /// Load the translation of `vpn` from `pageTable` into the TLB, as the
+    /// hardware does when `walkPageTable` is set, and return its entry.
+    /// Return null if the page is not present.
+    template <bool TRACE>
+    TranslationEntry *WalkPageTable(unsigned vpn);
+
     /// Translate an address, and check for alignment.
     ///
     /// Set the use and dirty bits in the translation entry appropriately,
     /// and return an exception code if the translation could not be
     /// completed.
+    template <bool TRACE, bool TLB>
     ExceptionType Translate(unsigned virtAddr, unsigned *physAddr,
                             unsigned size, bool writing);
 };
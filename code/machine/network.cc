@@ -58,7 +58,8 @@ Network::Network(NetworkAddress addr, double reliability,
     inHdr.length = 0;
 
     sock = SystemDep::OpenSocket();
-    snprintf(sockName, sizeof sockName, "SOCKET_%u", (unsigned) addr);
+    snprintf(sockName, sizeof sockName, "%sSOCKET_%u",
+             hostFilePrefix, (unsigned) addr);
     SystemDep::AssignNameToSocket(sockName, sock);
       // Bind socket to a filename in the current directory.
 
@@ -127,9 +128,10 @@ Network::Send(PacketHeader hdr, const char *data)
 {
     ASSERT(data != nullptr);
 
-    char toName[32];
+    char toName[64];
 
-    snprintf(toName, sizeof toName, "SOCKET_%u", (unsigned) hdr.to);
+    snprintf(toName, sizeof toName, "%sSOCKET_%u",
+             hostFilePrefix, (unsigned) hdr.to);
 
     ASSERT(!sendBusy && hdr.length > 0
            && hdr.length <= MAX_PACKET_SIZE && hdr.from == ident);
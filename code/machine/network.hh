@@ -104,7 +104,7 @@ private:
     int sock;
 
     /// File name corresponding to UNIX socket.
-    char sockName[32];
+    char sockName[64];
 
     /// Interrupt handler, signalling next packet can be sent.
     VoidFunctionPtr writeHandler;
@@ -0,0 +1,108 @@
+/// Routines to manage page tables.
+///
+/// DO NOT CHANGE -- part of the machine emulation
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "page_table.hh"
+
+
+PageTable::PageTable(unsigned numPages_)
+{
+    numPages = numPages_;
+
+#ifdef TWO_LEVEL_PAGE_TABLE
+    numTables = DivRoundUp(numPages, PAGES_PER_TABLE);
+    tables = new TranslationEntry * [numTables];
+    for (unsigned i = 0; i < numTables; i++) {
+        tables[i] = nullptr;
+    }
+    numAllocated = 0;
+#else
+    entries = new TranslationEntry [numPages];
+    Clear(entries, 0, numPages);
+#endif
+}
+
+PageTable::~PageTable()
+{
+#ifdef TWO_LEVEL_PAGE_TABLE
+    for (unsigned i = 0; i < numTables; i++) {
+        delete [] tables[i];
+    }
+    delete [] tables;
+#else
+    delete [] entries;
+#endif
+}
+
+TranslationEntry *
+PageTable::Get(unsigned vpn)
+{
+    ASSERT(vpn < numPages);
+
+#ifdef TWO_LEVEL_PAGE_TABLE
+    TranslationEntry **table = &tables[vpn / PAGES_PER_TABLE];
+    if (*table == nullptr) {
+        *table = new TranslationEntry [PAGES_PER_TABLE];
+        Clear(*table, vpn - vpn % PAGES_PER_TABLE, PAGES_PER_TABLE);
+        numAllocated++;
+    }
+    return &(*table)[vpn % PAGES_PER_TABLE];
+#else
+    return &entries[vpn];
+#endif
+}
+
+TranslationEntry *
+PageTable::Find(unsigned vpn) const
+{
+    ASSERT(vpn < numPages);
+
+#ifdef TWO_LEVEL_PAGE_TABLE
+    TranslationEntry *table = tables[vpn / PAGES_PER_TABLE];
+    return table == nullptr ? nullptr : &table[vpn % PAGES_PER_TABLE];
+#else
+    return &entries[vpn];
+#endif
+}
+
+unsigned
+PageTable::GetNumPages() const
+{
+    return numPages;
+}
+
+unsigned
+PageTable::GetSize() const
+{
+#ifdef TWO_LEVEL_PAGE_TABLE
+    return numTables * sizeof (TranslationEntry *)
+           + numAllocated * PAGES_PER_TABLE * sizeof (TranslationEntry);
+#else
+    return numPages * sizeof (TranslationEntry);
+#endif
+}
+
+void
+PageTable::Clear(TranslationEntry *entries, unsigned firstPage,
+                 unsigned count)
+{
+    ASSERT(entries != nullptr);
+
+    for (unsigned i = 0; i < count; i++) {
+        entries[i].virtualPage  = firstPage + i;
+        entries[i].physicalPage = 0;
+        entries[i].valid        = false;
+        entries[i].readOnly     = false;
+        entries[i].use          = false;
+        entries[i].dirty        = false;
+        entries[i].asid         = 0;
+#ifdef SWAP
+        entries[i].swapSlot     = NO_SWAP_SLOT;
+#endif
+    }
+}
@@ -0,0 +1,84 @@
+/// Data structures for page tables, that map the virtual pages of an
+/// address space to physical pages.
+///
+/// By default, a page table is linear: an array holding an entry for every
+/// virtual page, allocated all at once.
+///
+/// If `TWO_LEVEL_PAGE_TABLE` is defined at build time, the entries are
+/// split into second level tables of `PAGES_PER_TABLE` entries each, and
+/// the first level only holds pointers to them.  A second level table is
+/// allocated the first time one of its entries is asked for, so the memory
+/// taken grows with the pages that are touched, rather than with the size of
+/// the address space.
+///
+/// Either way, entries never move once created, so pointers to them stay
+/// valid as long as the table exists.
+///
+/// DO NOT CHANGE -- part of the machine emulation
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_PAGETABLE__HH
+#define NACHOS_MACHINE_PAGETABLE__HH
+
+
+#include "translation_entry.hh"
+
+
+#ifdef TWO_LEVEL_PAGE_TABLE
+/// Number of entries in every second level table.
+const unsigned PAGES_PER_TABLE = 64;
+#endif
+
+
+class PageTable {
+public:
+
+    /// Create a page table for `numPages` virtual pages, none of them
+    /// valid.
+    PageTable(unsigned numPages);
+
+    ~PageTable();
+
+    /// Return the entry of virtual page `vpn`, creating it if needed.
+    ///
+    /// New entries map `vpn` to no frame: they are not valid, and every
+    /// bit is clear.
+    TranslationEntry *Get(unsigned vpn);
+
+    /// Return the entry of virtual page `vpn`, or null if it was never
+    /// created, in which case the page is not valid.
+    TranslationEntry *Find(unsigned vpn) const;
+
+    /// Return the number of virtual pages that the table maps.
+    unsigned GetNumPages() const;
+
+    /// Return the number of bytes that the table takes.
+    unsigned GetSize() const;
+
+private:
+
+    /// Set `count` entries starting at `entries`, for the pages starting at
+    /// `firstPage`, to map no frame.
+    static void Clear(TranslationEntry *entries, unsigned firstPage,
+                      unsigned count);
+
+    unsigned numPages;
+
+#ifdef TWO_LEVEL_PAGE_TABLE
+    /// First level: one pointer per second level table, null until one of
+    /// its entries is asked for.
+    TranslationEntry **tables;
+    unsigned numTables;
+
+    /// Number of second level tables allocated.
+    unsigned numAllocated;
+#else
+    TranslationEntry *entries;
+#endif
+};
+
+
+#endif
@@ -21,6 +21,19 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numMemAccess = numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numTlbHits = numTlbMisses = numTlbWalks = numTlbPreloads = 0;
+    numTlbPreloadHits = 0;
+    numSwapWritten = numSwapRead = 0;
+    numSwapWrites = numSwapReads = 0;
+    numPoolStores = numPoolPageBytes = numPoolBytes = numPoolRejects = 0;
+    numPoolHits = numPoolMisses = numPoolSpills = 0;
+    numQuotaRaises = numQuotaCuts = numSuspensions = 0;
+    numFaultEvictions = numPageoutFrees = numPageoutWrites = 0;
+    numPageReclaims = 0;
+    numCowShares = numCowCopies = 0;
+    numTextLoads = numTextHits = 0;
+    numZeroMaps = numZeroAllocs = numZeroFills = numZeroedFrames = 0;
+    tlbPolicy[0] = '\0';
 #ifdef DFS_TICKS_FIX
     tickResets = 0;
 #endif
@@ -44,23 +57,63 @@ Statistics::Print()
     printf("Console I/O: reads %lu, writes %lu\n",
            numConsoleCharsRead, numConsoleCharsWritten);
 
-    // Ejercicio 2 plancha 4
-    // Nota: una lectura fallida a la TLB seguida de una lectura en memoria exitosa
-    // se considera una única lectura fallida
-    printf("VMEM\n");
-    unsigned long hits = numMemAccess - numPageFaults;
-    printf("NMemAccess: %lu, Hits: %lu, Misses: %lu, hit ratio: %.3lu\n",
-        numMemAccess,
-        hits,
-        numPageFaults,
-        (numMemAccess - 2*numPageFaults) / hits * 100);
-        // Se eliminan las lecturas repetidas: un miss seguido de un hit
-        // se contabiliza como un miss
-
-    // Ejercicio 4e plancha 4#
-    printf("Número de páginas escritas en swap%lu\nNúmero de páginas leídas de swap%lu\n",
-        numSwapWritten, numSwapRead);
-
+#ifdef USE_TLB
+    unsigned long lookups = numTlbHits + numTlbMisses;
+    printf("TLB (%s): hits %lu, misses %lu, hit ratio %.2f%%\n",
+           tlbPolicy, numTlbHits, numTlbMisses,
+           lookups == 0 ? 0.0 : 100.0 * numTlbHits / lookups);
+    if (numTlbWalks > 0) {
+        printf("TLB refills: by the hardware %lu, by the kernel %lu\n",
+               numTlbWalks, numTlbMisses - numTlbWalks);
+    }
+    if (numTlbPreloads > 0) {
+        printf("TLB warm-up: entries preloaded %lu, used %lu, hit ratio"
+               " %.2f%%\n", numTlbPreloads, numTlbPreloadHits,
+               100.0 * numTlbPreloadHits / numTlbPreloads);
+    }
+#endif
+#ifdef VMEM
+    printf("Paging: faults %lu, pages written to swap %lu, read from swap"
+           " %lu\n", numPageFaults, numSwapWritten, numSwapRead);
+    if (numSwapWrites + numSwapReads > 0) {
+        printf("Swap requests: writes %lu, reads %lu\n",
+               numSwapWrites, numSwapReads);
+    }
+    if (numPoolStores + numPoolRejects > 0) {
+        unsigned long reads = numPoolHits + numPoolMisses;
+        printf("Swap pool: pages stored %lu (%lu did not compress),"
+               " compression ratio %.2f, spilled %lu\n",
+               numPoolStores, numPoolRejects,
+               numPoolBytes == 0 ? 0.0
+                 : (double) numPoolPageBytes / numPoolBytes,
+               numPoolSpills);
+        printf("Swap pool: pages read %lu, hits %lu, hit ratio %.2f%%\n",
+               reads, numPoolHits,
+               reads == 0 ? 0.0 : 100.0 * numPoolHits / reads);
+    }
+    if (numQuotaRaises + numQuotaCuts + numSuspensions > 0) {
+        printf("Frame quotas: raised %lu, lowered %lu, suspensions %lu\n",
+               numQuotaRaises, numQuotaCuts, numSuspensions);
+    }
+    if (numPageoutFrees > 0) {
+        printf("Pageout: by page faults %lu, by the daemon %lu (%lu written,"
+               " %lu reclaimed)\n", numFaultEvictions, numPageoutFrees,
+               numPageoutWrites, numPageReclaims);
+    }
+    if (numCowShares > 0) {
+        printf("Copy-on-write: pages shared %lu, copied %lu\n",
+               numCowShares, numCowCopies);
+    }
+    if (numTextLoads > 0) {
+        printf("Shared text: pages loaded %lu, found in memory %lu\n",
+               numTextLoads, numTextHits);
+    }
+    if (numZeroMaps > 0) {
+        printf("Zero page: faults %lu, allocated on write %lu (%lu zeroed"
+               " then, %lu in the background)\n", numZeroMaps, numZeroAllocs,
+               numZeroFills, numZeroedFrames);
+    }
+#endif
     printf("Network I/O: packets received %lu, sent %lu\n",
            numPacketsRecvd, numPacketsSent);
 }
@@ -50,12 +50,90 @@ public:
     /// Number of virtual memory page faults.
     unsigned long numPageFaults;
 
+    /// Number of translations found in the TLB.
+    unsigned long numTlbHits;
+
+    /// Number of translations not found in the TLB.
+    unsigned long numTlbMisses;
+
+    /// Number of TLB misses refilled by the hardware page table walker,
+    /// without trapping to the kernel.
+    unsigned long numTlbWalks;
+
+    /// Number of translations loaded into the TLB ahead of use, when an
+    /// address space is run again.
+    unsigned long numTlbPreloads;
+
+    /// Number of those preloaded translations that were used before they
+    /// left the TLB.
+    unsigned long numTlbPreloadHits;
+
+    /// Name of the TLB replacement policy the hits and misses are due to,
+    /// set by the kernel.
+    char tlbPolicy[8];
+
     /// Number of pages written to swap
     unsigned long numSwapWritten;
 
     /// Number of pages read from swap
     unsigned long numSwapRead;
 
+    /// Number of requests made to the swap area to write and read those
+    /// pages, several at a time when clustered; not counting those served
+    /// by the swap pool.
+    unsigned long numSwapWrites;
+    unsigned long numSwapReads;
+
+    /// Number of pages kept compressed in the swap pool, and the bytes they
+    /// took, before and after; of pages that did not compress; of pages
+    /// read from the pool, and from the swap area; and of pages spilled out
+    /// of the pool.
+    unsigned long numPoolStores;
+    unsigned long numPoolPageBytes;
+    unsigned long numPoolBytes;
+    unsigned long numPoolRejects;
+    unsigned long numPoolHits;
+    unsigned long numPoolMisses;
+    unsigned long numPoolSpills;
+
+    /// Number of times the frame quota of an address space was raised and
+    /// lowered, by the page fault frequency controller.
+    unsigned long numQuotaRaises;
+    unsigned long numQuotaCuts;
+
+    /// Number of times an address space was suspended for lack of frames.
+    unsigned long numSuspensions;
+
+    /// Number of pages taken out of memory by page faults, for lack of free
+    /// frames.
+    unsigned long numFaultEvictions;
+
+    /// Number of pages taken out of memory by the pageout daemon, and how
+    /// many of them were written to swap.
+    unsigned long numPageoutFrees;
+    unsigned long numPageoutWrites;
+
+    /// Number of pages found still in a frame freed by the pageout daemon.
+    unsigned long numPageReclaims;
+
+    /// Number of pages shared by `Fork`, and of copies made when they were
+    /// written to.
+    unsigned long numCowShares;
+    unsigned long numCowCopies;
+
+    /// Number of code pages read from an executable, and of those found
+    /// already in memory, loaded by another address space running it.
+    unsigned long numTextLoads;
+    unsigned long numTextHits;
+
+    /// Number of page faults served by the frame of zeros, of frames given
+    /// to pages of zeros at their first write, and of those that had to be
+    /// zeroed then.  Also, number of free frames zeroed in the background.
+    unsigned long numZeroMaps;
+    unsigned long numZeroAllocs;
+    unsigned long numZeroFills;
+    unsigned long numZeroedFrames;
+
     /// Number of packets sent over the network.
     unsigned long numPacketsSent;
 
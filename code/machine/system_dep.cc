@@ -34,6 +34,7 @@ extern "C" {
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/file.h>
+#include <sys/stat.h>
 #include <sys/un.h>
 #include <sys/mman.h>
 #ifdef HOST_i386
@@ -191,6 +192,19 @@ Close(int fd)
     ASSERT(retVal >= 0);
 }
 
+/// Return a number that tells the file open as `fd` apart from any other
+/// on the host: its device and inode.
+///
+/// Abort on error.
+unsigned long long
+FileId(int fd)
+{
+    struct stat st;
+    int retVal = fstat(fd, &st);
+    ASSERT(retVal >= 0);
+    return (unsigned long long) st.st_dev << 40 ^ st.st_ino;
+}
+
 /// Delete a file.
 bool
 Unlink(const char *name)
@@ -338,6 +352,21 @@ Delay(unsigned seconds)
     sleep(seconds);
 }
 
+#ifdef __GLIBC__
+/// State of the pseudo-random number generator of the calling host thread.
+///
+/// It is the same generator that `srand` and `rand` use, so that a given
+/// seed yields the same sequence, but each instance of the kernel (see
+/// `KernelInstance`) gets its own.
+static thread_local char randomState[128];
+static thread_local struct random_data randomData;
+static thread_local bool randomReady = false;
+#endif
+
+/// Last seed, and how many numbers were drawn since, for `RandomGetState`.
+static thread_local unsigned randomSeed = 1;
+static thread_local unsigned long randomDrawn = 0;
+
 /// Initialize the pseudo-random number generator.
 ///
 /// We use the now obsolete `srand` and `rand` because they are more
@@ -345,14 +374,54 @@ Delay(unsigned seconds)
 void
 RandomInit(unsigned seed)
 {
+    randomSeed  = seed;
+    randomDrawn = 0;
+#ifdef __GLIBC__
+    randomData.state = nullptr;
+    initstate_r(seed, randomState, sizeof randomState, &randomData);
+    randomReady = true;
+#else
     srand(seed);
+#endif
 }
 
 /// Return a pseudo-random number.
 int
 Random()
 {
+#ifdef __GLIBC__
+    if (!randomReady) {
+        RandomInit(1);  // Same as `rand` without `srand`.
+    }
+    randomDrawn++;
+    int32_t result;
+    random_r(&randomData, &result);
+    return result;
+#else
+    randomDrawn++;
     return rand();
+#endif
+}
+
+void
+RandomGetState(unsigned *seed, unsigned long *drawn)
+{
+    ASSERT(seed != nullptr);
+    ASSERT(drawn != nullptr);
+
+    *seed  = randomSeed;
+    *drawn = randomDrawn;
+}
+
+/// The generator cannot jump ahead, so the numbers already drawn are drawn
+/// again.
+void
+RandomSetState(unsigned seed, unsigned long drawn)
+{
+    RandomInit(seed);
+    while (randomDrawn < drawn) {
+        Random();
+    }
 }
 
 /// Return an array, with the two pages just before and after the array
@@ -395,4 +464,30 @@ DeallocBoundedArray(const char *ptr, unsigned size)
     delete [] (ptr - pgSize);
 }
 
+/// Allocate a region of memory that can be both written and executed, for
+/// holding code generated at run time.
+///
+/// Returns null if the host does not allow it.
+///
+/// * `size` is the size of the region, in bytes.
+char *
+AllocExecutable(size_t size)
+{
+    ASSERT(size > 0);
+
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr == MAP_FAILED ? nullptr : (char *) ptr;
+}
+
+/// Release a region obtained from `AllocExecutable`.
+void
+DeallocExecutable(char *ptr, size_t size)
+{
+    ASSERT(ptr != nullptr);
+    ASSERT(size > 0);
+
+    munmap(ptr, size);
+}
+
 };
@@ -43,6 +43,9 @@ namespace SystemDep {
 
     void Close(int fd);
 
+    /// Tell the file open as `fd` apart from any other on the host.
+    unsigned long long FileId(int fd);
+
     bool Unlink(const char *name);
 
     /// Interprocess communication operations, for simulating the network.
@@ -75,12 +78,24 @@ namespace SystemDep {
 
     int Random();
 
+    /// Get/set the state of the pseudo random number generator, as the
+    /// last seed and the number of numbers drawn since then.
+    void RandomGetState(unsigned *seed, unsigned long *drawn);
+    void RandomSetState(unsigned seed, unsigned long drawn);
+
     /// Allocate, de-allocate an array, such that de-referencing just beyond
     /// either end of the array will cause an error.
 
     char *AllocBoundedArray(unsigned size);
 
     void DeallocBoundedArray(const char *p, unsigned size);
+
+    /// Allocate, de-allocate memory that can hold host code generated at
+    /// run time.
+
+    char *AllocExecutable(size_t size);
+
+    void DeallocExecutable(char *p, size_t size);
 };
 
 
@@ -21,6 +21,10 @@
 #include "lib/utility.hh"
 
 
+/// Value of `TranslationEntry::swapSlot` for pages that have no slot.
+const unsigned NO_SWAP_SLOT = (unsigned) -1;
+
+
 /// The following class defines an entry in a translation table -- either
 /// in a page table or a TLB.
 ///
@@ -54,6 +58,20 @@ public:
     /// This bit is set by the hardware every time the page is modified.
     bool dirty;
 
+    /// Identifier of the address space the translation belongs to.
+    ///
+    /// Only meaningful in the TLB, where an entry is ignored unless it
+    /// matches `MMU::currentAsid`.
+    unsigned asid;
+
+#ifdef SWAP
+    /// Slot of the swap area where the page is kept while out of memory,
+    /// or `NO_SWAP_SLOT` if it was never written out.
+    ///
+    /// Only meaningful in a page table; the hardware ignores it.
+    unsigned swapSlot;
+#endif
+
 };
 
 
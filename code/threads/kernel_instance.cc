@@ -0,0 +1,189 @@
+/// Routines to run several independent simulations in a single host
+/// process.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "kernel_instance.hh"
+#include "lib/utility.hh"
+#include "machine/system_dep.hh"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// External functions used by this file.
+
+int Boot(int argc, char **argv);
+
+/// Where `KernelInstance::Exit` goes back to, while an instance is running
+/// on this host thread.
+static thread_local jmp_buf *exitPoint = nullptr;
+
+/// Status given to `KernelInstance::Exit`, for `Run` to return.
+static thread_local int exitedWith;
+
+static const char *const SEPARATORS = " \t\r\n";
+
+/// * `line` is the command line, without the program name.
+/// * `number` tells the instance apart from the others in its batch.
+KernelInstance::KernelInstance(const char *line, unsigned number)
+{
+    ASSERT(line != nullptr);
+
+    unsigned length = strlen(line);
+    commandLine = new char [length + 1];
+    buffer      = new char [length + 1];
+    strcpy(commandLine, line);
+    strcpy(buffer, line);
+
+    // There cannot be more arguments than half the characters, rounding
+    // up; add the program name, a default prefix and a terminating null
+    // pointer.
+    argv = new char * [(length + 1) / 2 + 4];
+    argc = 0;
+    argv[argc++] = (char *) "nachos";
+    bool hasPrefix = false;
+    char *position;
+    for (char *arg = strtok_r(buffer, SEPARATORS, &position);
+         arg != nullptr;
+         arg = strtok_r(nullptr, SEPARATORS, &position)) {
+        argv[argc++] = arg;
+        hasPrefix = hasPrefix || !strcmp(arg, "-hp");
+    }
+    argv[argc] = nullptr;
+
+    // Otherwise instances would share their host files.  It goes first, as
+    // the arguments of the user program come last.
+    snprintf(prefix, sizeof prefix, "i%u.", number);
+    if (!hasPrefix) {
+        memmove(argv + 3, argv + 1, argc * sizeof *argv);
+        argv[1] = (char *) "-hp";
+        argv[2] = prefix;
+        argc += 2;
+    }
+}
+
+KernelInstance::~KernelInstance()
+{
+    delete [] commandLine;
+    delete [] buffer;
+    delete [] argv;
+}
+
+int
+KernelInstance::Run()
+{
+    ASSERT(exitPoint == nullptr);
+
+    jmp_buf point;
+    int status;
+
+    exitPoint = &point;
+    if (setjmp(point) == 0) {
+        SystemDep::RandomInit(1);  // As in a freshly started process.
+        status = Boot(argc, argv);
+    } else {
+        status = exitedWith;
+    }
+    exitPoint = nullptr;
+    return status;
+}
+
+const char *
+KernelInstance::GetCommandLine() const
+{
+    return commandLine;
+}
+
+void
+KernelInstance::Exit(int status)
+{
+    if (exitPoint == nullptr) {
+        exit(status);
+    }
+    exitedWith = status;
+    longjmp(*exitPoint, 1);
+}
+
+/// State shared by the host threads running a batch.
+struct Batch {
+    std::vector<KernelInstance *> instances;
+    std::vector<int> results;
+    std::atomic<unsigned> next;
+};
+
+/// Run instances of `batch` until there are none left.
+static void
+BatchWorker(Batch *batch)
+{
+    for (;;) {
+        unsigned i = batch->next++;
+        if (i >= batch->instances.size()) {
+            return;
+        }
+        batch->results[i] = batch->instances[i]->Run();
+    }
+}
+
+int
+RunBatchFile(const char *fileName, unsigned numThreads)
+{
+    ASSERT(fileName != nullptr);
+
+    FILE *f = fopen(fileName, "r");
+    if (f == nullptr) {
+        fprintf(stderr, "Unable to open batch file %s\n", fileName);
+        return 1;
+    }
+
+    Batch batch;
+    char line[1024];
+    while (fgets(line, sizeof line, f) != nullptr) {
+        const char *start = line + strspn(line, SEPARATORS);
+        if (*start == '\0' || *start == '#') {
+            continue;
+        }
+        start = strtok(line, "\r\n");
+        batch.instances.push_back(new KernelInstance(start,
+                                                     batch.instances.size()));
+    }
+    fclose(f);
+    batch.results.resize(batch.instances.size());
+    batch.next = 0;
+
+    if (numThreads == 0) {
+        numThreads = std::thread::hardware_concurrency();
+    }
+    if (numThreads == 0 || numThreads > batch.instances.size()) {
+        numThreads = batch.instances.size();
+    }
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < numThreads; i++) {
+        pool.push_back(std::thread(BatchWorker, &batch));
+    }
+    for (unsigned i = 0; i < numThreads; i++) {
+        pool[i].join();
+    }
+
+    int failed = 0;
+    for (unsigned i = 0; i < batch.instances.size(); i++) {
+        printf("Instance %u (%s): status %d\n", i,
+               batch.instances[i]->GetCommandLine(), batch.results[i]);
+        if (batch.results[i] != 0) {
+            failed++;
+        }
+        delete batch.instances[i];
+    }
+    printf("%u instances run on %u host threads, %d failed\n",
+           (unsigned) batch.instances.size(), numThreads, failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+/// Data structures for running several independent simulations in a single
+/// host process.
+///
+/// Every global object of the kernel (see `system.hh`) is local to the host
+/// thread that uses it, so each host thread can boot and run a complete
+/// Nachos kernel of its own, with its own machine, devices and simulated
+/// time.  A `KernelInstance` is one such kernel: it is created from a
+/// command line, just like the one given to the `nachos` program, and runs
+/// it to completion on the calling host thread.
+///
+/// Instances only share what the host process shares: standard output,
+/// `ASSERT` failures (which abort the whole process) and host signals.  Host
+/// files used by the devices (`DISK`, `SWAP`, `SOCKET_*`) are kept apart by
+/// the `-hp` flag, which defaults to the number of the instance.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_KERNELINSTANCE__HH
+#define NACHOS_THREADS_KERNELINSTANCE__HH
+
+
+class KernelInstance {
+public:
+
+    /// Prepare an instance that boots with the arguments in `commandLine`,
+    /// separated by blanks, not including the program name.
+    ///
+    /// Unless they include `-hp`, the names of its host files are prefixed
+    /// with `i<number>.`, so they are not the ones of any other instance.
+    KernelInstance(const char *commandLine, unsigned number);
+
+    ~KernelInstance();
+
+    /// Boot the kernel on the calling host thread and run it until it
+    /// halts.
+    ///
+    /// Return the status the kernel finished with.  An instance can only be
+    /// run once, and a host thread can only run one instance at a time.
+    int Run();
+
+    const char *GetCommandLine() const;
+
+    /// Leave the instance running on the calling host thread, after the
+    /// kernel has been cleaned up, making `Run` return `status`.  Never
+    /// returns.
+    ///
+    /// If no instance is running on this host thread, the whole process
+    /// exits with `status`, as Nachos always did.
+    static void Exit(int status);
+
+private:
+
+    char *commandLine;
+    char *buffer;  ///< Holds the arguments pointed to by `argv`.
+    char prefix[16];  ///< Default prefix of the host files.
+    int argc;
+    char **argv;
+};
+
+/// Run every simulation listed in the host file `fileName`, one command
+/// line per line, using a pool of `numThreads` host threads.
+///
+/// Blank lines and lines starting with `#` are ignored.  If `numThreads`
+/// is 0, one host thread per host processor is used.
+///
+/// Return 0 if every instance finished with status 0.
+int RunBatchFile(const char *fileName, unsigned numThreads);
+
+
+#endif
@@ -11,13 +11,19 @@
 /// =====
 ///
 ///     nachos [-d <debugflags>] [-do <debugopts>] [-p]
-///            [-rs <random seed #>] [-z] [-tt]
-///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
+///            [-rs <random seed #>] [-hp <host file prefix>]
+///            [-cr <snapshot file>] [-cs <snapshot file>] [-z] [-tt]
+///            [-s] [-j] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
+///            [-io <consoleIn> <consoleOut>] [-mc <ticks per word>]
+///            [-ps <page size>] [-np <number of frames>] [-ts <tlb size>]
+///            [-tp <tlb policy>] [-tw] [-tr] [-pf]
 ///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
 ///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf]
 ///            [-n <network reliability>] [-id <machine id>]
 ///            [-tn <other machine id>]
 ///
+///     nachos -batch <batch file> [<host threads>]
+///
 /// General options
 /// ---------------
 ///
@@ -27,6 +33,14 @@
 ///            debugging messages.
 /// * `-p`  -- enables preemptive multitasking for kernel threads.
 /// * `-rs` -- causes `Yield` to occur at random (but repeatable) spots.
+/// * `-hp` -- prefixes the names of the host files used by the simulated
+///            devices (disk, swap, network sockets) with the given string.
+/// * `-cr` -- restores a snapshot of the machine right after booting (see
+///            `snapshot.hh`); the kernel must be given the same flags as
+///            the one that saved it.
+/// * `-cs` -- saves a snapshot of the machine at this point of the command
+///            line, for instance after formatting the disk and copying
+///            files into it.
 /// * `-z`  -- prints version and copyright information, and exits.
 ///
 /// *THREADS* options
@@ -39,8 +53,35 @@
 /// ----------------------
 ///
 /// * `-s`  -- causes user programs to be executed in single-step mode.
+/// * `-j`  -- runs frequently executed user code translated into host code
+///            (x86-64 hosts only), instead of interpreting it.
 /// * `-x`  -- runs a user program.
 /// * `-tc` -- tests the console.
+/// * `-io` -- reads the console input from, and writes its output to, the
+///            given host files instead of the terminal.
+/// * `-mc` -- sets the ticks charged for every word processed by the
+///            memory system calls (`MemCopy`, `MemSet`...); 1 by default.
+/// * `-ps` -- sets the size of pages, in bytes: a power of two, the size of
+///            a disk sector by default.
+/// * `-np` -- sets the number of frames of the main memory; 32 by default.
+///            Together with `-ps`, the memory can be made as large as the
+///            host allows, up to 4 GiB.
+///
+/// *VMEM* options
+/// --------------
+///
+/// * `-tp` -- sets the policy to replace entries of the TLB (*USE_TLB*):
+///            `fifo` (the default), `random`, `clock` or `lru` (see
+///            `tlb_manager.hh`).
+/// * `-tw` -- lets the hardware refill the TLB by walking the page table
+///            of the running address space, so that only pages that are not
+///            in memory cause page faults (*USE_TLB*).
+/// * `-tr` -- reloads into the TLB the translations that a process had
+///            there when it stopped running, when it runs again (*USE_TLB*).
+/// * `-pf` -- like `-tr`, also loading the translations of the pages of
+///            the program counter and the stack pointer.
+/// * `-ts` -- sets the number of entries of the TLB (*USE_TLB*); 4 by
+///            default, unless `TLB_ENTRIES` is defined at build time.
 ///
 /// *FILESYS* options
 /// -----------------
@@ -61,6 +102,17 @@
 /// * `-id` -- sets this machine's host id (needed for the network).
 /// * `-tn` -- runs a simple test of the Nachos network software.
 ///
+/// Batch mode
+/// ----------
+///
+/// * `-batch` -- runs every simulation listed in the batch file, one
+///               command line (without the program name) per line, on a
+///               pool of host threads; by default, one per host processor.
+///               Each simulation boots a kernel of its own (see
+///               `kernel_instance.hh`); those not given a `-hp` prefix get
+///               `i<n>.`, after their line among the simulations, so their
+///               host files are kept apart.
+///
 /// ----
 ///
 /// NOTE: flags are ignored until the relevant assignment.
@@ -74,16 +126,16 @@
 
 
 #include "copyright.h"
+#include "kernel_instance.hh"
+#include "snapshot.hh"
 #include "sys_info.hh"
 #include "system.hh"
 #include "thread_test.hh"
 #include "lib/utility.hh"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#ifdef NETWORK
-    #include <stdlib.h>
-#endif
 
 
 // External functions used by this file.
@@ -115,8 +167,11 @@ PrintVersion()
 /// * `argv` is an array of strings, one for each command line argument.
 ///   Example:
 ///       nachos -d +  ->  argv = {"nachos", "-d", "+"}
+///
+/// The kernel runs on the calling host thread and only returns (from
+/// `KernelInstance::Run`, or by exiting the process) once it halts.
 int
-main(int argc, char **argv)
+Boot(int argc, char **argv)
 {
     int argCount;  // The number of arguments for a particular command.
 
@@ -133,6 +188,13 @@ main(int argc, char **argv)
             PrintVersion();
             return 0;
         }
+        if (!strcmp(*argv, "-cs")) {         // Save a snapshot.
+            ASSERT(argc > 1);
+            if (!SaveSnapshot(*(argv + 1))) {
+                printf("Unable to save snapshot %s\n", *(argv + 1));
+            }
+            argCount = 2;
+        }
 #ifdef THREADS
         if (!strcmp(*argv, "-tt")) {         // Test the threading subsystem.
             ThreadTest();
@@ -214,3 +276,14 @@ main(int argc, char **argv)
       // returning.
     return 0;  // Not reached...
 }
+
+/// Boot a single kernel, or a whole batch of them if the first argument is
+/// `-batch`.
+int
+main(int argc, char **argv)
+{
+    if (argc > 2 && !strcmp(argv[1], "-batch")) {
+        return RunBatchFile(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+    }
+    return Boot(argc, argv);
+}
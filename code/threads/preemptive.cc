@@ -24,7 +24,10 @@ static void ContextSwitch();
 static void MonitorProcess(int childPid, unsigned long timeSliceLength);
 static void LetMeBeMonitored();
 
-static bool inContextSwitch = false;
+/// Every kernel instance has its own.  The monitor reads the one of the host
+/// thread that forked it: after `fork`, it is at the same address in both
+/// processes.
+static thread_local bool inContextSwitch = false;
 
 /// Set up the preemptive scheduler.
 ///
@@ -9,6 +9,15 @@
 /// needed to wait for a lock, and the lock was busy, we would end up calling
 /// `FindNextToRun`, and that would put us in an infinite loop.
 ///
+/// NOTE: the kernel cannot simply be spread over several host threads, one
+/// per simulated CPU.  Besides relying on disabled interrupts for mutual
+/// exclusion, every thread switch is done by `SWITCH` on the host thread
+/// that runs the whole simulation, and the kernel, the `Machine` and the
+/// devices share global state (`currentThread`, `interrupt`, `stats`...)
+/// whose order of updates defines the simulated time.  Running user
+/// programs in parallel would make every run depend on the host scheduler.
+/// Independent simulations, on the other hand, can run in parallel.
+///
 /// Very simple implementation -- no priorities, straight FIFO.  Might need
 /// to be improved in later assignments.
 ///
@@ -0,0 +1,305 @@
+/// Routines to save and restore snapshots of the simulated machine.
+///
+/// A snapshot file holds, in this order:
+///
+/// * a header: magic number, format version and kernel configuration,
+///   including (*USER_PROGRAM*) the page size, number of frames and TLB
+///   size;
+/// * (*FILESYS*) the disk head state, followed by the non-zero sectors as
+///   pairs of sector number and contents, ended by `NUM_SECTORS`;
+/// * the number of pending interrupts, followed by their kinds and times;
+/// * the `Statistics` object;
+/// * the seed and count of the pseudo random number generator;
+/// * (*USER_PROGRAM*) the registers, the TLB if any, and the non-zero frames
+///   as pairs of frame number and contents, ended by `NUM_PHYS_PAGES`.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "snapshot.hh"
+#include "system.hh"
+
+#include <stdio.h>
+
+
+static const unsigned SNAPSHOT_MAGIC   = 0x4E534E50;  // "NSNP".
+static const unsigned SNAPSHOT_VERSION = 2;
+
+/// Return the build options that change what a snapshot holds.
+static unsigned
+Configuration()
+{
+    unsigned options = 0;
+#ifdef USER_PROGRAM
+    options |= 1 << 0;
+#endif
+#ifdef FILESYS
+    options |= 1 << 1;
+#endif
+#ifdef USE_TLB
+    options |= 1 << 2;
+#endif
+#ifdef VMEM
+    options |= 1 << 3;
+#endif
+    return options << 16 | sizeof (Statistics);
+}
+
+template <class T>
+static inline void
+Put(FILE *f, const T &value)
+{
+    fwrite(&value, sizeof value, 1, f);
+}
+
+template <class T>
+static inline bool
+Get(FILE *f, T *value)
+{
+    return fread(value, sizeof *value, 1, f) == 1;
+}
+
+#if defined(USER_PROGRAM) || defined(FILESYS)
+static bool
+IsZero(const char *data, unsigned size)
+{
+    for (unsigned i = 0; i < size; i++) {
+        if (data[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Write the blocks of `size` bytes of `data` that are not all zeros, out
+/// of `count`, each preceded by its number, followed by `count`.
+static void
+PutBlocks(FILE *f, const char *data, unsigned count, unsigned size)
+{
+    for (unsigned i = 0; i < count; i++) {
+        if (!IsZero(&data[i * size], size)) {
+            Put(f, i);
+            fwrite(&data[i * size], size, 1, f);
+        }
+    }
+    Put(f, count);
+}
+
+/// Read back what `PutBlocks` wrote into `data`, setting to zero the
+/// blocks that are missing.
+static bool
+GetBlocks(FILE *f, char *data, unsigned count, unsigned size)
+{
+    unsigned next = 0;
+    for (;;) {
+        unsigned i;
+        if (!Get(f, &i) || i < next || i > count) {
+            return false;
+        }
+        for (; next < i; next++) {
+            for (unsigned j = 0; j < size; j++) {
+                data[next * size + j] = 0;
+            }
+        }
+        if (i == count) {
+            return true;
+        }
+        if (fread(&data[i * size], size, 1, f) != 1) {
+            return false;
+        }
+        next = i + 1;
+    }
+}
+#endif
+
+bool
+SaveSnapshot(const char *fileName)
+{
+    ASSERT(fileName != nullptr);
+
+    FILE *f = fopen(fileName, "wb");
+    if (f == nullptr) {
+        return false;
+    }
+    DEBUG('t', "Saving snapshot to %s at time %lu\n",
+          fileName, stats->totalTicks);
+
+    Put(f, SNAPSHOT_MAGIC);
+    Put(f, SNAPSHOT_VERSION);
+    Put(f, Configuration());
+#ifdef USER_PROGRAM
+    Put(f, PAGE_SIZE);
+    Put(f, NUM_PHYS_PAGES);
+    Put(f, TLB_SIZE);
+#endif
+
+#ifdef FILESYS
+    Disk *disk = synchDisk->GetDisk();
+    unsigned lastSector;
+    int      bufferInit;
+    disk->GetHeadState(&lastSector, &bufferInit);
+    Put(f, lastSector);
+    Put(f, bufferInit);
+
+    char *sectors = new char [NUM_SECTORS * SECTOR_SIZE];
+    for (unsigned i = 0; i < NUM_SECTORS; i++) {
+        disk->ReadSectorNow(i, &sectors[i * SECTOR_SIZE]);
+    }
+    PutBlocks(f, sectors, NUM_SECTORS, SECTOR_SIZE);
+    delete [] sectors;
+#endif
+
+    unsigned numPending = interrupt->GetPending(nullptr, nullptr, 0);
+    IntType       *types = new IntType [numPending];
+    unsigned long *whens = new unsigned long [numPending];
+    interrupt->GetPending(types, whens, numPending);
+    Put(f, numPending);
+    for (unsigned i = 0; i < numPending; i++) {
+        Put(f, types[i]);
+        Put(f, whens[i]);
+    }
+    delete [] types;
+    delete [] whens;
+
+    Put(f, *stats);
+
+    unsigned      seed;
+    unsigned long drawn;
+    SystemDep::RandomGetState(&seed, &drawn);
+    Put(f, seed);
+    Put(f, drawn);
+
+#ifdef USER_PROGRAM
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        Put(f, machine->ReadRegister(i));
+    }
+    MMU *mmu = machine->GetMMU();
+    if (mmu->tlb != nullptr) {
+        for (unsigned i = 0; i < TLB_SIZE; i++) {
+            Put(f, mmu->tlb[i]);
+        }
+    }
+    PutBlocks(f, mmu->mainMemory, NUM_PHYS_PAGES, PAGE_SIZE);
+#endif
+
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
+
+/// Do the actual work of `RestoreSnapshot`, on the already open file `f`.
+static bool
+Restore(FILE *f)
+{
+    unsigned magic, version, configuration;
+    if (!Get(f, &magic) || magic != SNAPSHOT_MAGIC
+          || !Get(f, &version) || version != SNAPSHOT_VERSION
+          || !Get(f, &configuration) || configuration != Configuration()) {
+        return false;
+    }
+#ifdef USER_PROGRAM
+    unsigned pageSize, numPhysPages, tlbSize;
+    if (!Get(f, &pageSize) || pageSize != PAGE_SIZE
+          || !Get(f, &numPhysPages) || numPhysPages != NUM_PHYS_PAGES
+          || !Get(f, &tlbSize) || tlbSize != TLB_SIZE) {
+        return false;
+    }
+#endif
+
+#ifdef FILESYS
+    Disk *disk = synchDisk->GetDisk();
+    unsigned lastSector;
+    int      bufferInit;
+    if (!Get(f, &lastSector) || lastSector >= NUM_SECTORS
+          || !Get(f, &bufferInit)) {
+        return false;
+    }
+
+    char *sectors = new char [NUM_SECTORS * SECTOR_SIZE];
+    bool sectorsOk = GetBlocks(f, sectors, NUM_SECTORS, SECTOR_SIZE);
+    if (sectorsOk) {
+        for (unsigned i = 0; i < NUM_SECTORS; i++) {
+            disk->WriteSectorNow(i, &sectors[i * SECTOR_SIZE]);
+        }
+    }
+    delete [] sectors;
+    if (!sectorsOk) {
+        return false;
+    }
+
+    // The file system keeps the headers of the bitmap and the directory in
+    // memory, so it has to read them again.  The time this takes is
+    // overwritten right below.
+    delete fileSystem;
+    fileSystem = new FileSystem(false);
+    disk->SetHeadState(lastSector, bufferInit);
+#endif
+
+    unsigned numPending;
+    if (!Get(f, &numPending)) {
+        return false;
+    }
+    IntType       *types = new IntType [numPending];
+    unsigned long *whens = new unsigned long [numPending];
+    bool pendingOk = true;
+    for (unsigned i = 0; pendingOk && i < numPending; i++) {
+        pendingOk = Get(f, &types[i]) && Get(f, &whens[i]);
+    }
+    pendingOk = pendingOk && interrupt->SetPending(types, whens, numPending);
+    delete [] types;
+    delete [] whens;
+    if (!pendingOk) {
+        return false;
+    }
+
+    unsigned      seed;
+    unsigned long drawn;
+    if (!Get(f, stats) || !Get(f, &seed) || !Get(f, &drawn)) {
+        return false;
+    }
+    SystemDep::RandomSetState(seed, drawn);
+
+#ifdef USER_PROGRAM
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        int value;
+        if (!Get(f, &value)) {
+            return false;
+        }
+        machine->WriteRegister(i, value);
+    }
+    MMU *mmu = machine->GetMMU();
+    if (mmu->tlb != nullptr) {
+        for (unsigned i = 0; i < TLB_SIZE; i++) {
+            if (!Get(f, &mmu->tlb[i])) {
+                return false;
+            }
+        }
+    }
+    if (!GetBlocks(f, mmu->mainMemory, NUM_PHYS_PAGES, PAGE_SIZE)) {
+        return false;
+    }
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        mmu->InvalidateFrame(i);
+    }
+#endif
+
+    return true;
+}
+
+bool
+RestoreSnapshot(const char *fileName)
+{
+    ASSERT(fileName != nullptr);
+
+    FILE *f = fopen(fileName, "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    bool ok = Restore(f);
+    fclose(f);
+
+    DEBUG('t', "Restored snapshot from %s at time %lu\n",
+          fileName, stats->totalTicks);
+    return ok;
+}
@@ -0,0 +1,51 @@
+/// Routines to save and restore snapshots of the simulated machine.
+///
+/// A snapshot lets a run resume right where an earlier one left off, for
+/// instance after formatting the disk and copying programs into it, instead
+/// of repeating that setup before every measurement.
+///
+/// Snapshots are taken between the actions requested on the command line
+/// (see `main.cc`), where only the main kernel thread exists and no user
+/// program is running.  There, threads, scheduler queues, page tables and
+/// the core map are exactly as any boot leaves them, so what a snapshot
+/// holds is:
+///
+/// * the statistics, including the simulated time;
+/// * the kind and time of every pending interrupt;
+/// * the state of the pseudo random number generator;
+/// * the CPU registers, the TLB and every non-zero frame of the main memory
+///   (*USER_PROGRAM*);
+/// * the position of the disk head and every non-zero sector of the disk
+///   (*FILESYS*).
+///
+/// A snapshot is restored at the end of `Initialize`, over a freshly booted
+/// kernel.  It must have been saved by a kernel built with the same options
+/// and booted with the same flags regarding interrupts (`-rs`, `-p`...),
+/// since the devices that schedule them are not re-created, and the same
+/// memory geometry (`-ps`, `-np`, `-ts`).
+///
+/// Values are stored in host byte order, so snapshots are not meant to be
+/// moved between different hosts.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_SNAPSHOT__HH
+#define NACHOS_THREADS_SNAPSHOT__HH
+
+
+/// Save the state of the machine into the host file `fileName`.
+///
+/// Return false if the file could not be written.
+bool SaveSnapshot(const char *fileName);
+
+/// Bring the machine to the state saved in the host file `fileName`.
+///
+/// Return false if the file could not be read, or it was saved by a
+/// different kind of kernel, in which case the machine is left in an
+/// inconsistent state.
+bool RestoreSnapshot(const char *fileName);
+
+
+#endif
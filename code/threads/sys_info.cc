@@ -43,6 +43,16 @@ void SysInfo()
 #endif
       ;
 
+#ifdef USER_PROGRAM
+    unsigned pageSize     = PAGE_SIZE;
+    unsigned numPhysPages = NUM_PHYS_PAGES;
+    unsigned tlbSize      = TLB_SIZE;
+#else  // There is no machine; show its defaults.
+    unsigned pageSize     = DEFAULT_PAGE_SIZE;
+    unsigned numPhysPages = DEFAULT_NUM_PHYS_PAGES;
+    unsigned tlbSize      = DEFAULT_TLB_SIZE;
+#endif
+
     printf("System information.\n");
     printf("\n\
 General:\n\
@@ -55,7 +65,7 @@ Memory:\n\
   Number of pages: %u.\n\
   Number of TLB entries: %u.\n\
   Memory size: %u bytes.\n",
-  PAGE_SIZE,NUM_PHYS_PAGES,TLB_SIZE,MEMORY_SIZE);
+  pageSize, numPhysPages, tlbSize, pageSize * numPhysPages);
     printf("\n\
 Disk:\n\
   Sector size: %u bytes.\n\
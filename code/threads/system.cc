@@ -7,13 +7,16 @@
 
 
 #include "system.hh"
+#include "kernel_instance.hh"
 #include "preemptive.hh"
+#include "snapshot.hh"
 
 #ifdef USER_PROGRAM
 #include "userprog/debugger.hh"
 #include "userprog/exception.hh"
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -22,39 +25,53 @@
 ///
 /// These are all initialized and de-allocated by this file.
 
-Thread *currentThread;        ///< The thread we are running now.
-Thread *threadToBeDestroyed;  ///< The thread that just finished.
-Scheduler *scheduler;         ///< The ready list.
-Interrupt *interrupt;         ///< Interrupt status.
-Statistics *stats;            ///< Performance metrics.
-Timer *timer;                 ///< The hardware timer device, for invoking
-                              ///< context switches.
+thread_local Thread *currentThread;        ///< The thread we are running
+                                           ///< now.
+thread_local Thread *threadToBeDestroyed;  ///< The thread that just
+                                           ///< finished.
+thread_local Scheduler *scheduler;         ///< The ready list.
+thread_local Interrupt *interrupt;         ///< Interrupt status.
+thread_local Statistics *stats;            ///< Performance metrics.
+thread_local Timer *timer;                 ///< The hardware timer device, for
+                                           ///< invoking context switches.
+
+thread_local const char *hostFilePrefix = "";
+thread_local int haltStatus;
 
 // 2007, Jose Miguel Santos Espino
-PreemptiveScheduler *preemptiveScheduler = nullptr;
+thread_local PreemptiveScheduler *preemptiveScheduler = nullptr;
 const long long DEFAULT_TIME_SLICE = 50000;
 
 #ifdef FILESYS_NEEDED
-FileSystem *fileSystem;
+thread_local FileSystem *fileSystem;
 #endif
 
 #ifdef FILESYS
-SynchDisk *synchDisk;
+thread_local SynchDisk *synchDisk;
 #endif
 
 #ifdef USER_PROGRAM  // Requires either *FILESYS* or *FILESYS_STUB*.
-Machine *machine;  ///< User program memory and registers.
-SynchConsole *synchConsole;
-Table <Thread*> *threadTable;
-Bitmap *pageMap;
+thread_local Machine *machine;  ///< User program memory and registers.
+thread_local SynchConsole *synchConsole;
+thread_local Table <Thread*> *threadTable;
+thread_local Bitmap *pageMap;
+thread_local unsigned memoryOpTicks;
 #endif
 
 #ifdef VMEM
-CoreMap *coreMap;
+thread_local CoreMap *coreMap;
+#endif
+
+#ifdef USE_TLB
+thread_local TLBManager *tlbManager;
+#endif
+
+#ifdef SWAP
+thread_local SwapArea *swapArea;
 #endif
 
 #ifdef NETWORK
-PostOffice *postOffice;
+thread_local PostOffice *postOffice;
 #endif
 
 // External definition, to allow us to take a pointer to this function.
@@ -77,6 +94,13 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(void *dummy)
 {
+#ifdef PFF
+    if (coreMap != nullptr) {
+        // None waits too long, nor for nothing when the machine is idle:
+        // then the thread that was running is blocked.
+        coreMap->ResumeSuspended(currentThread->GetStatus() == BLOCKED);
+    }
+#endif
     if (interrupt->GetStatus() != IDLE_MODE) {
         interrupt->YieldOnReturn();
     }
@@ -136,14 +160,32 @@ Initialize(int argc, char **argv)
     const char *debugFlags = "";
     DebugOpts debugOpts;
     bool randomYield = false;
+    const char *snapshotFile = nullptr;  // Snapshot to restore, if any.
 
     // 2007, Jose Miguel Santos Espino
     bool preemptiveScheduling = false;
     long long timeSlice;
 
+    hostFilePrefix = "";
+    haltStatus = 0;
+
 #ifdef USER_PROGRAM
     bool debugUserProg = false;  // Single step user program.
+    bool translateUserProg = false;  // Run user code translated to host
+                                     // code.
+    const char *consoleIn = nullptr;   // Console input file, if not the
+    const char *consoleOut = nullptr;  // terminal; same for output.
+    memoryOpTicks = 1;
     threadTable = new Table <Thread*>();
+    unsigned pageSize = DEFAULT_PAGE_SIZE;            // Machine memory
+    unsigned numPhysPages = DEFAULT_NUM_PHYS_PAGES;  // geometry.
+    unsigned tlbSize = DEFAULT_TLB_SIZE;
+#endif
+#ifdef USE_TLB
+    TLBPolicy tlbPolicy = TLB_FIFO;  // TLB replacement policy.
+    bool walkPageTable = false;  // Refill the TLB in hardware.
+    bool tlbWarmUp = false;      // Reload the TLB on context switches.
+    bool tlbPrefetch = false;    // Also load the PC and stack pages.
 #endif
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
@@ -183,10 +225,54 @@ Initialize(int argc, char **argv)
                 timeSlice = atoi(*(argv+1));
                 argCount = 2;
             }
+        } else if (!strcmp(*argv, "-hp")) {
+            ASSERT(argc > 1);
+            hostFilePrefix = *(argv + 1);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-cr")) {
+            ASSERT(argc > 1);
+            snapshotFile = *(argv + 1);
+            argCount = 2;
         }
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-s")) {
             debugUserProg = true;
+        } else if (!strcmp(*argv, "-j")) {
+            translateUserProg = true;
+        } else if (!strcmp(*argv, "-io")) {
+            ASSERT(argc > 2);
+            consoleIn = *(argv + 1);
+            consoleOut = *(argv + 2);
+            argCount = 3;
+        } else if (!strcmp(*argv, "-mc")) {
+            ASSERT(argc > 1);
+            memoryOpTicks = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ps")) {
+            ASSERT(argc > 1);
+            pageSize = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-np")) {
+            ASSERT(argc > 1);
+            numPhysPages = atoi(*(argv + 1));
+            argCount = 2;
+        }
+#endif
+#ifdef USE_TLB
+        if (!strcmp(*argv, "-tp")) {
+            ASSERT(argc > 1);
+            ASSERT(TLBManager::ParsePolicy(*(argv + 1), &tlbPolicy));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tw")) {
+            walkPageTable = true;
+        } else if (!strcmp(*argv, "-tr")) {
+            tlbWarmUp = true;
+        } else if (!strcmp(*argv, "-pf")) {
+            tlbPrefetch = true;
+        } else if (!strcmp(*argv, "-ts")) {
+            ASSERT(argc > 1);
+            tlbSize = atoi(*(argv + 1));
+            argCount = 2;
         }
 #endif
 #ifdef FILESYS_NEEDED
@@ -207,6 +293,16 @@ Initialize(int argc, char **argv)
 #endif
     }
 
+#ifdef USER_PROGRAM
+    // Checked before anything is set up, so there is nothing to clean up.
+    if (!SetMemoryGeometry(pageSize, numPhysPages, tlbSize)) {
+        fprintf(stderr, "Invalid memory geometry: pages of %u bytes, %u "
+                "frames (at least %u), %u TLB entries\n",
+                pageSize, numPhysPages, MIN_NUM_PHYS_PAGES, tlbSize);
+        KernelInstance::Exit(1);
+    }
+#endif
+
     debug.SetFlags(debugFlags);  // Initialize `DEBUG` messages.
     debug.SetOpts(debugOpts);    // Set debugging behavior.
     stats = new Statistics;      // Collect statistics.
@@ -234,9 +330,9 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     Debugger *d = debugUserProg ? new Debugger : nullptr;
-    machine = new Machine(d);  // This must come first.
+    machine = new Machine(d, translateUserProg);  // This must come first.
 
-    synchConsole = new SynchConsole(nullptr, nullptr);
+    synchConsole = new SynchConsole(consoleIn, consoleOut);
     pageMap = new Bitmap(NUM_PHYS_PAGES);
 
     SetExceptionHandlers();
@@ -246,17 +342,36 @@ Initialize(int argc, char **argv)
     coreMap = new CoreMap();
 #endif
 
+#ifdef USE_TLB
+    tlbManager = new TLBManager(tlbPolicy, tlbWarmUp, tlbPrefetch);
+    machine->GetMMU()->walkPageTable = walkPageTable;
+#endif
+
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    char *diskName = new char [strlen(hostFilePrefix) + 5];
+    sprintf(diskName, "%sDISK", hostFilePrefix);
+    synchDisk = new SynchDisk(diskName);
+    delete [] diskName;
 #endif
 
 #ifdef FILESYS_NEEDED
     fileSystem = new FileSystem(format);
 #endif
 
+#ifdef SWAP
+    swapArea = new SwapArea();
+#endif
+
 #ifdef NETWORK
     postOffice = new PostOffice(netname, rely, 10);
 #endif
+
+    // Everything is in place; now bring it to the saved state.
+    if (snapshotFile != nullptr && !RestoreSnapshot(snapshotFile)) {
+        fprintf(stderr, "Unable to restore snapshot %s\n", snapshotFile);
+        haltStatus = 1;
+        Cleanup();
+    }
 }
 
 /// Nachos is halting.  De-allocate global data structures.
@@ -267,11 +382,17 @@ Cleanup()
 
     // 2007, Jose Miguel Santos Espino
     delete preemptiveScheduler;
+    preemptiveScheduler = nullptr;
 
 #ifdef NETWORK
     delete postOffice;
 #endif
 
+    // Before any device it may use is gone.
+#ifdef SWAP
+    delete swapArea;
+#endif
+
 #ifdef USER_PROGRAM
     delete machine;
     delete synchConsole;
@@ -283,6 +404,10 @@ Cleanup()
     delete coreMap;
 #endif
 
+#ifdef USE_TLB
+    delete tlbManager;
+#endif
+
 #ifdef FILESYS_NEEDED
     delete fileSystem;
 #endif
@@ -296,5 +421,5 @@ Cleanup()
     delete interrupt;
     delete stats;
 
-    exit(0);
+    KernelInstance::Exit(haltStatus);  // Never returns.
 }
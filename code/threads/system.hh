@@ -1,5 +1,8 @@
 /// All global variables used in Nachos are defined here.
 ///
+/// Each host thread has its own copy of them, so that several instances of
+/// the kernel can run in the same process (see `KernelInstance`).
+///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
 /// All rights reserved.  See `copyright.h` for copyright notice and
@@ -28,39 +31,62 @@ extern void Initialize(int argc, char **argv);
 extern void Cleanup();
 
 
-extern Thread *currentThread;        ///< The thread holding the CPU.
-extern Thread *threadToBeDestroyed;  ///< The thread that just finished.
-extern Scheduler *scheduler;         ///< The ready list.
-extern Interrupt *interrupt;         ///< Interrupt status.
-extern Statistics *stats;            ///< Performance metrics.
-extern Timer *timer;                 ///< The hardware alarm clock.
+extern thread_local Thread *currentThread;        ///< The thread holding
+                                                  ///< the CPU.
+extern thread_local Thread *threadToBeDestroyed;  ///< The thread that just
+                                                  ///< finished.
+extern thread_local Scheduler *scheduler;         ///< The ready list.
+extern thread_local Interrupt *interrupt;         ///< Interrupt status.
+extern thread_local Statistics *stats;            ///< Performance metrics.
+extern thread_local Timer *timer;                 ///< The hardware alarm
+                                                  ///< clock.
+
+/// Prefix for the names of the host files that Nachos creates (the disk
+/// image, the swap area and network sockets).
+extern thread_local const char *hostFilePrefix;
+
+/// Status the kernel exits with when it halts: the first non-zero one that
+/// a user program exited with, if any, or 1 if it could not boot as asked.
+extern thread_local int haltStatus;
 
 #ifdef USER_PROGRAM
 #include "machine/machine.hh"
-extern Machine *machine;  // User program memory and registers.
-extern SynchConsole *synchConsole;
-extern Table <Thread*> *threadTable;
-extern Bitmap *pageMap;
+extern thread_local Machine *machine;  // User program memory and registers.
+extern thread_local SynchConsole *synchConsole;
+extern thread_local Table <Thread*> *threadTable;
+extern thread_local Bitmap *pageMap;
+extern thread_local unsigned memoryOpTicks;  // Ticks charged per word by the
+                                             // memory system calls.
 #endif
 
 #ifdef VMEM
 #include "vmem/core_map.hh"
-extern CoreMap *coreMap;
+extern thread_local CoreMap *coreMap;
+#endif
+
+#ifdef USE_TLB
+#include "vmem/tlb_manager.hh"
+extern thread_local TLBManager *tlbManager;
 #endif
 
 #ifdef FILESYS_NEEDED  // *FILESYS* or *FILESYS_STUB*.
 #include "filesys/file_system.hh"
-extern FileSystem *fileSystem;
+extern thread_local FileSystem *fileSystem;
 #endif
 
 #ifdef FILESYS
 #include "filesys/synch_disk.hh"
-extern SynchDisk *synchDisk;
+extern thread_local SynchDisk *synchDisk;
+#endif
+
+#ifdef SWAP
+#include "vmem/swap_area.hh"
+extern thread_local SwapArea *swapArea;
 #endif
 
 #ifdef NETWORK
 #include "network/post.hh"
-extern PostOffice *postOffice;
+extern thread_local PostOffice *postOffice;
 #endif
 
 
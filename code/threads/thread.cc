@@ -173,6 +173,12 @@ Thread::SetStatus(ThreadStatus st)
     status = st;
 }
 
+ThreadStatus
+Thread::GetStatus() const
+{
+    return status;
+}
+
 const char *
 Thread::GetName() const
 {
@@ -199,6 +205,16 @@ Thread::Print() const
 void
 Thread::Finish(int returnValue)
 {
+#ifdef USER_PROGRAM
+    // Its memory is given back while still running in the thread, since it
+    // may have to wait for pages that are on their way to the swap area.
+    if (space != nullptr) {
+        AddressSpace *oldSpace = space;
+        space = nullptr;
+        delete oldSpace;
+    }
+#endif
+
     interrupt->SetLevel(INT_OFF);
     ASSERT(this == currentThread);
 
@@ -144,6 +144,8 @@ public:
 
     void SetStatus(ThreadStatus st);
 
+    ThreadStatus GetStatus() const;
+
     const char *GetName() const;
 
     void Print() const;
@@ -6,9 +6,9 @@
 
 static const unsigned CANT_SENDERS = 10;
 static const unsigned CANT_RECEIVERS = 10;
-static bool done[CANT_SENDERS + CANT_RECEIVERS];
+static thread_local bool done[CANT_SENDERS + CANT_RECEIVERS];
 
-static Channel *channel = new Channel("Canal de comunic");
+static thread_local Channel *channel;
 
 static void
 Sender(void *n_)
@@ -40,6 +40,11 @@ Receiver(void *n_)
 void
 ThreadTestChannel()
 {
+    channel = new Channel("Canal de comunic");
+    for (unsigned i = 0; i < CANT_SENDERS + CANT_RECEIVERS; i++) {
+        done[i] = false;
+    }
+
     // Launch a new thread for each sender.
     for (unsigned i = 0; i < CANT_SENDERS; i++) {
         printf("Launching sender %u.\n", i);
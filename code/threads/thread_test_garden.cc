@@ -13,8 +13,8 @@
 
 static const unsigned NUM_TURNSTILES = 2;
 static const unsigned ITERATIONS_PER_TURNSTILE = 50;
-static bool done[NUM_TURNSTILES];
-static int count;
+static thread_local bool done[NUM_TURNSTILES];
+static thread_local int count;
 
 static void
 Turnstile(void *n_)
@@ -33,6 +33,11 @@ Turnstile(void *n_)
 void
 ThreadTestGarden()
 {
+    count = 0;
+    for (unsigned i = 0; i < NUM_TURNSTILES; i++) {
+        done[i] = false;
+    }
+
     // Launch a new thread for each turnstile.
     for (unsigned i = 0; i < NUM_TURNSTILES; i++) {
         printf("Launching turnstile %u.\n", i);
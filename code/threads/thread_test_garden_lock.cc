@@ -10,13 +10,13 @@
 
 #include <stdio.h>
 #include "lock.hh"
-static Lock *lock = new Lock("Lock initialization");
+static thread_local Lock *lock;
 
 
 static const unsigned NUM_TURNSTILES = 2;
 static const unsigned ITERATIONS_PER_TURNSTILE = 50;
-static bool done[NUM_TURNSTILES];
-static int count;
+static thread_local bool done[NUM_TURNSTILES];
+static thread_local int count;
 
 static void
 TurnstileLock(void *n_)
@@ -42,6 +42,12 @@ TurnstileLock(void *n_)
 void
 ThreadTestGardenLock()
 {
+    lock = new Lock("Lock initialization");
+    count = 0;
+    for (unsigned i = 0; i < NUM_TURNSTILES; i++) {
+        done[i] = false;
+    }
+
     // Launch a new thread for each turnstile.
     for (unsigned i = 0; i < NUM_TURNSTILES; i++) {
         printf("Launching turnstile %u.\n", i);
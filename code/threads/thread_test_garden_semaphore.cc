@@ -10,13 +10,13 @@
 
 #include <stdio.h>
 #include "semaphore.hh"
-static Semaphore *sem = new Semaphore("Semaphore initialization.", 1);
+static thread_local Semaphore *sem;
 
 
 static const unsigned NUM_TURNSTILES = 2;
 static const unsigned ITERATIONS_PER_TURNSTILE = 50;
-static bool done[NUM_TURNSTILES];
-static int count;
+static thread_local bool done[NUM_TURNSTILES];
+static thread_local int count;
 
 static void
 TurnstileSemaphore(void *n_)
@@ -42,6 +42,12 @@ TurnstileSemaphore(void *n_)
 void
 ThreadTestGardenSemaphore()
 {
+    sem = new Semaphore("Semaphore initialization.", 1);
+    count = 0;
+    for (unsigned i = 0; i < NUM_TURNSTILES; i++) {
+        done[i] = false;
+    }
+
     // Launch a new thread for each turnstile.
     for (unsigned i = 0; i < NUM_TURNSTILES; i++) {
         printf("Launching turnstile %u.\n", i);
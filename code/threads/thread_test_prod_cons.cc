@@ -14,15 +14,15 @@
 
 static const unsigned CANT_PRODUCTORES = 1;
 static const unsigned CANT_CONSUMIDORES = 5;
-static bool done[CANT_CONSUMIDORES + CANT_PRODUCTORES];
+static thread_local bool done[CANT_CONSUMIDORES + CANT_PRODUCTORES];
 
 static const unsigned N_MAX_PRODUCTOS = 6;
-static unsigned n_elementos = 0;
+static thread_local unsigned n_elementos;
 
-static List <unsigned> *elementos = new List <unsigned>;
-static Lock *l = new Lock("Mutex");
-static Condition *elementosDisponibles = new Condition("Elementos", l);
-static Condition *espaciosDisponibles = new Condition("Espacios", l);
+static thread_local List <unsigned> *elementos;
+static thread_local Lock *l;
+static thread_local Condition *elementosDisponibles;
+static thread_local Condition *espaciosDisponibles;
 
 static void
 Producer(void *n_)
@@ -72,6 +72,15 @@ Consumer(void *n_)
 void
 ThreadTestProdCons()
 {
+    n_elementos = 0;
+    elementos = new List <unsigned>;
+    l = new Lock("Mutex");
+    elementosDisponibles = new Condition("Elementos", l);
+    espaciosDisponibles = new Condition("Espacios", l);
+    for (unsigned i = 0; i < CANT_CONSUMIDORES + CANT_PRODUCTORES; i++) {
+        done[i] = false;
+    }
+
     // Launch a new thread for each producer.
     for (unsigned i = 0; i < CANT_PRODUCTORES; i++) {
       printf("Launching productor %u.\n", i);
@@ -17,7 +17,7 @@
 // Test Semaphore plancha 1 ejercicio 15
 #ifdef SEMAPHORE_TEST
 #include "semaphore.hh"
-static Semaphore *sem = new Semaphore("Semaphore test.", 3);
+static thread_local Semaphore *sem;
 #endif
 
 /// Loop 10 times, yielding the CPU to another ready thread each iteration.
@@ -61,7 +61,10 @@ ThreadTestSimple()
 {
     DEBUG('t', "Entering thread test\n");
 
-    
+#ifdef SEMAPHORE_TEST
+    sem = new Semaphore("Semaphore test.", 3);
+#endif
+
     for (unsigned nthread = 2; nthread <= 5; nthread++) {
         char *name = new char [64];
         std::string str = std::to_string(nthread) + std::string("-");
@@ -5,9 +5,7 @@ unsigned strlen(const char *s) {
 
     if(s == NULL) return 0;
 
-    unsigned i;
-    for (i = 0; s[i] != '\0'; i++);
-    return i;
+    return StrLen(s);
 }
 
 void putss(const char *s) {
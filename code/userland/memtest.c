@@ -0,0 +1,70 @@
+/// Test the memory system calls on buffers that span several pages, none
+/// of which has been touched yet, so that the kernel has to service page
+/// faults in the middle of each call.
+///
+/// Prints `memtest: ok` if every check passes, and halts.
+
+
+#include "syscall.h"
+
+
+#define SIZE 512
+
+/// Longer than a page, in initialized data, which is only loaded when
+/// first used.
+static const char TEXT[] =
+    "This string spans more than one page of the address space, so that "
+    "measuring its length has to bring in a page that the program itself "
+    "never touched, while the kernel is in the middle of a system call.  "
+    "It says nothing else of interest, but it goes on for a while longer, "
+    "just to be sure.";
+
+static char src[SIZE];
+static char dst[SIZE];
+static char zeros1[SIZE];
+static char zeros2[SIZE];
+
+static void
+Fail(const char *message, unsigned length)
+{
+    Write("memtest: ", 9, CONSOLE_OUTPUT);
+    Write(message, length, CONSOLE_OUTPUT);
+    Write(" failed\n", 8, CONSOLE_OUTPUT);
+    Halt();
+}
+
+int
+main(void)
+{
+    if (MemSet(src, 'x', SIZE) != 0) {
+        Fail("MemSet", 6);
+    }
+    for (unsigned i = 0; i < SIZE; i++) {
+        if (src[i] != 'x') {
+            Fail("MemSet", 6);
+        }
+    }
+
+    if (MemCopy(dst, src, SIZE) != 0) {
+        Fail("MemCopy", 7);
+    }
+    for (unsigned i = 0; i < SIZE; i++) {
+        if (dst[i] != 'x') {
+            Fail("MemCopy", 7);
+        }
+    }
+
+    if (StrLen(TEXT) != sizeof TEXT - 1) {
+        Fail("StrLen", 6);
+    }
+
+    if (MemCompare(zeros1, zeros2, SIZE) != 0
+          || MemCompare(src, dst, SIZE) != 0
+          || MemCompare(zeros1, src, SIZE) >= 0) {
+        Fail("MemCompare", 10);
+    }
+
+    Write("memtest: ok\n", 12, CONSOLE_OUTPUT);
+    Halt();
+    return 0;
+}
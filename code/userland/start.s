@@ -141,6 +141,38 @@ Print:
         j       $31
         .end    Print
 
+        .globl  MemCopy
+        .ent    MemCopy
+MemCopy:
+        addiu   $2, $0, SC_MEM_COPY
+        syscall
+        j       $31
+        .end    MemCopy
+
+        .globl  MemSet
+        .ent    MemSet
+MemSet:
+        addiu   $2, $0, SC_MEM_SET
+        syscall
+        j       $31
+        .end    MemSet
+
+        .globl  StrLen
+        .ent    StrLen
+StrLen:
+        addiu   $2, $0, SC_STR_LEN
+        syscall
+        j       $31
+        .end    StrLen
+
+        .globl  MemCompare
+        .ent    MemCompare
+MemCompare:
+        addiu   $2, $0, SC_MEM_COMPARE
+        syscall
+        j       $31
+        .end    MemCompare
+
 /// Dummy function to keep gcc happy.
         .globl  __main
         .ent    __main
@@ -8,12 +8,14 @@
 
 #include "address_space.hh"
 #include "executable.hh"
+#include "threads/lock.hh"
+#include "threads/semaphore.hh"
 #include "threads/system.hh"
 
 #include <stdio.h>
 #include <string.h>
 
-#ifndef VMEM
+#ifndef DEMAND_LOADING
 
 static uint32_t VirtualPageIndex(uint32_t virtualAddress){
   return virtualAddress / PAGE_SIZE;
@@ -23,20 +25,16 @@ static uint32_t VirtualPageOffset(uint32_t virtualAddress){
   return virtualAddress % PAGE_SIZE;
 }
 
-static unsigned VirtualToPhysical(unsigned virtualAddr, TranslationEntry *pageTable) {
+static unsigned VirtualToPhysical(unsigned virtualAddr, PageTable *pageTable) {
     unsigned virtualPageIndex = VirtualPageIndex(virtualAddr);
     unsigned virtualPageOffset = VirtualPageOffset(virtualAddr);
-    unsigned frame = pageTable[virtualPageIndex].physicalPage;
+    unsigned frame = pageTable->Get(virtualPageIndex)->physicalPage;
     return frame * PAGE_SIZE + virtualPageOffset;
 }
 
 #endif
 
-static uint32_t VirtualPageAddress(uint32_t vpn){
-  return vpn * PAGE_SIZE;
-}
-
-AddressSpace::AddressSpace(OpenFile *executable_file, SpaceId spaceId)
+AddressSpace::AddressSpace(OpenFile *executable_file)
 {
     ASSERT(executable_file != nullptr);
 
@@ -58,46 +56,75 @@ AddressSpace::AddressSpace(OpenFile *executable_file, SpaceId spaceId)
     DEBUG('a', "Initializing address space, num pages %u, size %u\n",
           numPages, size);
 
-    // First, set up the translation.
-    pageTable = new TranslationEntry[numPages];
+    // First, set up the translation.  Every page starts out invalid.
+    pageTable = new PageTable(numPages);
+#ifndef DEMAND_LOADING // Ejercicio 1 plancha 4
     for (unsigned i = 0; i < numPages; i++) {
-        pageTable[i].virtualPage  = i;
-#ifdef DEMAND_LOADING // Ejercicio 1 plancha 4
-        pageTable[i].physicalPage = numPages; // Invalidada por demand loading
-        pageTable[i].valid        = false;
-#else
+        TranslationEntry *entry = pageTable->Get(i);
         int newPage = pageMap->Find();
         ASSERT(newPage != -1);
-        pageTable[i].physicalPage = (unsigned int) newPage;
-        pageTable[i].valid        = true;
-#endif
-        pageTable[i].use          = false;
-        pageTable[i].dirty        = false;
-        pageTable[i].readOnly     = false;
+        machine->GetMMU()->InvalidateFrame(newPage);
+        entry->physicalPage = (unsigned int) newPage;
+        entry->valid        = true;
           // If the code segment was entirely on a separate page, we could
           // set its pages to be read-only.
     }
-
-// Ejercicio 4b plancha 4
-#ifdef SWAP
-    const unsigned SWAP_FILENAME = MAX_SWAP_FILENAME + 6; // length(SWAP.\0)
-    swapFileName = new char[SWAP_FILENAME];
-    snprintf(swapFileName, SWAP_FILENAME, "SWAP.%i", spaceId);
-
-    // size = exe->GetSize() + USER_STACK_SIZE
-    fileSystem->Create(swapFileName, size);
-    swapFile = fileSystem->Open(swapFileName);
-
 #endif
 
 #ifdef VMEM
     exec_file = executable_file;
+    execId = executable_file->GetId();
+    execFileUsers = new unsigned (1);
+
+    numResident   = 0;
+    numPageFaults = 0;
+#ifdef PFF
+    resume = new Semaphore("resume", 0);
+    coreMap->Admit(this);
+#endif
+#endif
+#ifdef DEMAND_LOADING
+    coreMap->AddSpace(this);
+
+    uint32_t codeEnd = exe.GetCodeAddr() + exe.GetCodeSize();
+    uint32_t initDataEnd = exe.GetInitDataAddr() + exe.GetInitDataSize();
+    firstZeroPage = DivRoundUp(codeEnd > initDataEnd ? codeEnd : initDataEnd,
+                               PAGE_SIZE);
+
+    // The pages of code that no data segment falls on; a data segment in
+    // the middle of the code leaves out the code after it.
+    uint32_t textStart = exe.GetCodeAddr();
+    uint32_t textEnd = codeEnd;
+    const uint32_t dataSegments[2][2] = {
+        { exe.GetInitDataAddr(),   exe.GetInitDataSize()   },
+        { exe.GetUninitDataAddr(), exe.GetUninitDataSize() }
+    };
+    for (unsigned i = 0; i < 2; i++) {
+        uint32_t addr = dataSegments[i][0], end = addr + dataSegments[i][1];
+        if (addr == end || addr >= textEnd || end <= textStart) {
+            continue;
+        }
+        if (addr > textStart) {
+            textEnd = addr;
+        } else {
+            textStart = end < textEnd ? end : textEnd;
+        }
+    }
+    firstTextPage = DivRoundUp(textStart, PAGE_SIZE);
+    endTextPage = textEnd / PAGE_SIZE;
+    if (endTextPage < firstTextPage) {
+        endTextPage = firstTextPage;
+    }
+    DEBUG('a', "Shared text pages %u to %u, zero pages from %u\n",
+          firstTextPage, endTextPage, firstZeroPage);
+#endif
 
-#else    
+#ifndef DEMAND_LOADING
     char *mainMemory = machine->GetMMU()->mainMemory;
 
     for (unsigned i = 0; i < numPages; i++){
-        memset(mainMemory + i * PAGE_SIZE, 0, PAGE_SIZE);
+        memset(mainMemory + pageTable->Get(i)->physicalPage * PAGE_SIZE, 0,
+               PAGE_SIZE);
     }
 
     // copy in the code and data segments into memory.
@@ -120,7 +147,6 @@ AddressSpace::AddressSpace(OpenFile *executable_file, SpaceId spaceId)
         uint32_t virtualAddr = exe.GetInitDataAddr();
         DEBUG('a', "Initializing data segment, at 0x%X, size %u\n",
               virtualAddr, initDataSize);
-        exe.ReadDataBlock(&mainMemory[virtualAddr], initDataSize, 0);
 
         unsigned physicalAddr;
         for(unsigned codeByte = 0; codeByte < initDataSize; codeByte++){
@@ -132,24 +158,125 @@ AddressSpace::AddressSpace(OpenFile *executable_file, SpaceId spaceId)
 
 }
 
+AddressSpace::AddressSpace(AddressSpace *parent)
+{
+    ASSERT(parent != nullptr);
+
+    numPages = parent->numPages;
+    DEBUG('a', "Forking address space, num pages %u\n", numPages);
+
+    pageTable = new PageTable(numPages);
+
+#ifdef VMEM
+    exec_file = parent->exec_file;
+    execId = parent->execId;
+    execFileUsers = parent->execFileUsers;
+    (*execFileUsers)++;
+
+    numResident   = 0;
+    numPageFaults = 0;
+#ifdef PFF
+    resume = new Semaphore("resume", 0);
+    coreMap->Admit(this);
+#endif
+#endif
+
+#ifdef DEMAND_LOADING
+    coreMap->AddSpace(this);
+    firstTextPage = parent->firstTextPage;
+    endTextPage = parent->endTextPage;
+    firstZeroPage = parent->firstZeroPage;
+
+    // Every page is where it is for `parent`, and both map those in memory
+    // read-only.  Their bits are taken out of the TLB first.
+    coreMap->pagingLock->Acquire();
+    for (unsigned i = 0; i < numPages; i++) {
+        TranslationEntry *from = parent->pageTable->Find(i);
+        if (from == nullptr) {
+            continue;
+        }
+        #ifdef USE_TLB
+        tlbManager->Invalidate(parent, i);
+        #endif
+        TranslationEntry *to = pageTable->Get(i);
+        *to = *from;
+    #ifdef SWAP
+        to->swapSlot = NO_SWAP_SLOT;
+    #endif
+        if (from->valid) {
+            from->readOnly = true;
+            to->readOnly = true;
+            if (from->physicalPage != coreMap->GetZeroFrame()) {
+                coreMap->Share(from->physicalPage, this);
+                stats->numCowShares++;
+            }
+        }
+    }
+    machine->GetMMU()->FlushHostCache();
+  #ifdef SWAP
+    CopySwap(parent);
+  #endif
+    coreMap->pagingLock->Release();
+#else
+    char *mainMemory = machine->GetMMU()->mainMemory;
+
+    ASSERT(numPages <= pageMap->CountClear());
+    for (unsigned i = 0; i < numPages; i++) {
+        const TranslationEntry *from = parent->pageTable->Get(i);
+        TranslationEntry *to = pageTable->Get(i);
+        int newPage = pageMap->Find();
+        machine->GetMMU()->InvalidateFrame(newPage);
+        *to = *from;
+        to->physicalPage = newPage;
+        memcpy(mainMemory + newPage * PAGE_SIZE,
+               mainMemory + from->physicalPage * PAGE_SIZE, PAGE_SIZE);
+    }
+#endif
+}
+
 /// Deallocate an address space.
 AddressSpace::~AddressSpace()
 {
+#ifdef USE_TLB
+    tlbManager->Release(this);  // Only its own entries leave the TLB.
+    if (machine->GetMMU()->pageTable == pageTable) {
+        machine->GetMMU()->pageTable = nullptr;
+    }
+#endif
+
+#ifdef DEMAND_LOADING
+    coreMap->ReleasePages(this);
+#else
     for (unsigned i = 0; i < numPages; i++)
-        pageMap->Clear(pageTable[i].physicalPage);
+        pageMap->Clear(pageTable->Get(i)->physicalPage);
+#endif
 
-    delete [] pageTable;
+#ifdef VMEM
+    DEBUG('a', "Deallocating address space, %lu page faults\n",
+          numPageFaults);
+#endif
+#ifdef SWAP
+    // Its clusters of the swap area are free again.
+    for (unsigned i = 0; i < numPages; i += SWAP_CLUSTER) {
+        unsigned cluster = FindCluster(i);
+        if (cluster != NO_SWAP_SLOT) {
+            swapArea->Free(cluster);
+        }
+    }
+#endif
+    DEBUG('a', "Deallocating address space, page table of %u bytes\n",
+          pageTable->GetSize());
+    delete pageTable;
 
     #ifdef VMEM
-        delete exec_file;
+        if (--*execFileUsers == 0) {
+            delete exec_file;
+            delete execFileUsers;
+        }
     #endif
 
-    // Ejercicio 4b plancha 4
-    #ifdef SWAP
-        coreMap->ReleasePages(this);
-        fileSystem->Remove(swapFileName);
-        delete [] swapFileName;
-        delete swapFile;
+    #ifdef PFF
+        delete resume;
     #endif
 }
 
@@ -184,65 +311,87 @@ AddressSpace::InitRegisters()
 /// On a context switch, save any machine state, specific to this address
 /// space, that needs saving.
 ///
-/// For now, nothing!
+/// For now, nothing!  Under *USE_TLB*, the entries of this address space
+/// stay in the TLB, tagged with its ASID, and their `use` and `dirty` bits
+/// are saved when they leave it; which ones are there is remembered, to
+/// warm the TLB up when it runs again.
 void
 AddressSpace::SaveState()
 {
-    #ifdef VMEM // Ejercicio 1 (no indicado en el enunciado) - Plancha 4
-    TranslationEntry *tlb = machine -> GetMMU() -> tlb;
-    for(unsigned i = 0; i < TLB_SIZE; i++){
-          if(tlb[i].valid){
-              unsigned pageIndex = tlb[i].virtualPage;
-              pageTable[pageIndex].use = tlb[i].use;
-              pageTable[pageIndex].dirty = tlb[i].dirty;
-          }
-      }
-    #endif
+  #ifdef USE_TLB
+  tlbManager->Record(this);
+  #endif
 }
 
 /// On a context switch, restore the machine state so that this address space
 /// can run.
 ///
-/// For now, tell the machine where to find the page table.
+/// For now, tell the machine where to find the page table; or, under
+/// *USE_TLB*, which entries of the TLB to use (and the page table too, if
+/// the hardware walks it).
 void
 AddressSpace::RestoreState()
 {
-  #ifdef VMEM  // Ejercicio 1a - Plancha 4
-  // Invalidar TLB
-  for(unsigned int i = 0 ; i < TLB_SIZE ; i++){
-    machine->GetMMU()->tlb[i].valid = false;
+  #ifdef USE_TLB  // Ejercicio 1a - Plancha 4
+  MMU *mmu = machine->GetMMU();
+  if (mmu->walkPageTable) {  // The hardware refills the TLB from it.
+      mmu->pageTable = pageTable;
   }
+  tlbManager->SwitchTo(this);
+  tlbManager->WarmUp(this);
   #else
-  machine->GetMMU()->pageTable     = pageTable;
-  machine->GetMMU()->pageTableSize = numPages;
+  machine->GetMMU()->pageTable = pageTable;
+  machine->GetMMU()->FlushHostCache();
   #endif
 }
 
+unsigned
+AddressSpace::GetNumPages() const
+{
+    return numPages;
+}
+
 #ifdef DEMAND_LOADING
 
+/// Fill the frame at `physPageAddr` with the virtual page starting at
+/// `virtualAddr`, as found in the executable: the parts of the code and
+/// initialized data segments that fall on it, and zeros elsewhere.
 void
 AddressSpace::ReadPage(char *mainMemory, uint32_t virtualAddr, int physPageAddr) {
 
     Executable exe (exec_file);
     ASSERT(exe.CheckMagic());
 
+    char *page = mainMemory + physPageAddr;
+    memset(page, 0, PAGE_SIZE);
+
     uint32_t codeSize = exe.GetCodeSize();
     uint32_t initDataSize = exe.GetInitDataSize();
     uint32_t initCodeAddr = exe.GetCodeAddr();
     uint32_t initDataAddr = exe.GetInitDataAddr();
+    uint32_t pageEnd = virtualAddr + PAGE_SIZE;
 
-    if(virtualAddr <= initCodeAddr + codeSize) {
+    if (codeSize > 0 && virtualAddr < initCodeAddr + codeSize
+          && pageEnd > initCodeAddr) {
         // Está en el segmento de código
-        exe.ReadCodeBlock(mainMemory + physPageAddr * PAGE_SIZE, PAGE_SIZE, virtualAddr);
+        uint32_t start = virtualAddr > initCodeAddr ? virtualAddr : initCodeAddr;
+        uint32_t end = pageEnd < initCodeAddr + codeSize
+                       ? pageEnd : initCodeAddr + codeSize;
+        exe.ReadCodeBlock(page + (start - virtualAddr), end - start,
+                          start - initCodeAddr);
+    }
 
-    } else if (virtualAddr <= initDataAddr + initDataSize) {
+    if (initDataSize > 0 && virtualAddr < initDataAddr + initDataSize
+          && pageEnd > initDataAddr) {
         // Está en el segmento de datos
-        exe.ReadDataBlock(mainMemory + physPageAddr * PAGE_SIZE, PAGE_SIZE, virtualAddr);
-        
-    } else {
-        // Está en el segmento stack
-        memset(mainMemory + physPageAddr * PAGE_SIZE, 0, PAGE_SIZE);
+        uint32_t start = virtualAddr > initDataAddr ? virtualAddr : initDataAddr;
+        uint32_t end = pageEnd < initDataAddr + initDataSize
+                       ? pageEnd : initDataAddr + initDataSize;
+        exe.ReadDataBlock(page + (start - virtualAddr), end - start,
+                          start - initDataAddr);
     }
+
+    // El resto (datos no inicializados y stack) queda en cero.
 }
 
 
@@ -254,29 +403,121 @@ AddressSpace::LoadPage(int vpn) {
     uint32_t virtualAddr = vpn * PAGE_SIZE;
     char *mainMemory = machine->GetMMU()->mainMemory;
 
-    int newPage = coreMap->BookPage(vpn, this);
-    int physPageAddr = newPage * PAGE_SIZE;
+    coreMap->pagingLock->Acquire();
+    TranslationEntry *entry = pageTable->Get(vpn);
+    // Code that was never written to is as in the executable, and the
+    // rest of the pages, zeros.
+    bool text = IsText(vpn);
+    bool zero = vpn >= (int) firstZeroPage;
+#ifdef SWAP
+    text = text && entry->swapSlot == NO_SWAP_SLOT;
+    zero = zero && entry->swapSlot == NO_SWAP_SLOT;
+#endif
+    bool shared = false;
 
-    if (pageTable[vpn].physicalPage == numPages || pageTable[vpn].physicalPage != numPages + 1) {
-        // Está invalidada por política de demand loading o
-        // No está en el área de intercambio
-        pageTable[vpn].physicalPage = newPage;
-        ReadPage(mainMemory, virtualAddr, physPageAddr);
-    } else {
-        // Está en el área de intercambio
-        pageTable[vpn].physicalPage = newPage;
-        ReadFromSwap(vpn, physPageAddr);
-        stats->numSwapRead++;
+    int newPage = -1;
+#ifdef PAGEOUT_DAEMON
+    // The pageout daemon may have freed its frame, not reused yet.
+    newPage = coreMap->Reclaim(vpn, this);
+#endif
+    if (newPage == -1 && zero) {
+        // Mapped to the frame of zeros until written to.
+        newPage = coreMap->GetZeroFrame();
+        shared = true;
+        stats->numZeroMaps++;
+    }
+    if (newPage == -1 && text) {
+        // Another address space running the executable may have read it.
+        newPage = coreMap->FindText(execId, vpn);
+        if (newPage != -1) {
+            coreMap->Share(newPage, this);
+            shared = true;
+            stats->numTextHits++;
+        }
+    }
+    if (newPage == -1) {
+        newPage = coreMap->BookPage(vpn, this);
+        int physPageAddr = newPage * PAGE_SIZE;
+
+#ifdef SWAP
+        if (entry->swapSlot != NO_SWAP_SLOT) {
+            // Está en el área de intercambio
+            ReadFromSwap(vpn, physPageAddr);
+        } else
+#endif
+        {
+            // Nunca fue modificada: se lee del ejecutable
+            ReadPage(mainMemory, virtualAddr, physPageAddr);
+            if (text) {
+                stats->numTextLoads++;
+            }
+        }
     }
+    if (text && !shared) {
+        coreMap->CacheText(newPage, execId);
+    }
+
+    entry->virtualPage = vpn;
+    entry->physicalPage = newPage;
+    entry->valid = true;
+    entry->readOnly = text || zero;
+    entry->use = false;
+    entry->dirty = false;
+    coreMap->pagingLock->Release();
 
-    pageTable[vpn].virtualPage = vpn;
-    pageTable[vpn].physicalPage = newPage;
-    pageTable[vpn].valid = true;
-    pageTable[vpn].readOnly = false;
-    pageTable[vpn].use = false;
-    pageTable[vpn].dirty = false;
-    
-    return pageTable[vpn];
+    return *entry;
+}
+
+bool
+AddressSpace::IsText(unsigned vpn) const {
+    return vpn >= firstTextPage && vpn < endTextPage;
+}
+
+void
+AddressSpace::CopyOnWrite(unsigned vpn) {
+    char *mainMemory = machine->GetMMU()->mainMemory;
+
+    coreMap->pagingLock->Acquire();
+    #ifdef USE_TLB
+    tlbManager->Invalidate(this, vpn);
+    #endif
+    TranslationEntry *entry = pageTable->Find(vpn);
+    if (entry == nullptr || !entry->valid || !entry->readOnly) {
+        // It was taken out of memory meanwhile, and is loaded back writable.
+        coreMap->pagingLock->Release();
+        return;
+    }
+
+    unsigned frame = entry->physicalPage;
+    if (frame == coreMap->GetZeroFrame()) {
+        entry->valid = false;
+        int newPage = coreMap->BookPage(vpn, this, true);
+        entry->physicalPage = newPage;
+        entry->valid = true;
+        entry->use = false;
+        entry->dirty = true;
+        stats->numZeroAllocs++;
+    } else if (coreMap->Unshare(frame, this)) {
+        // The others may take the frame out while another one is booked.
+        // Kernel stacks are too small for a page.
+        char *copy = new char [PAGE_SIZE];
+        memcpy(copy, mainMemory + frame * PAGE_SIZE, PAGE_SIZE);
+        entry->valid = false;
+
+        int newPage = coreMap->BookPage(vpn, this);
+        memcpy(mainMemory + newPage * PAGE_SIZE, copy, PAGE_SIZE);
+        delete [] copy;
+        entry->physicalPage = newPage;
+        entry->valid = true;
+        entry->use = false;
+        entry->dirty = true;
+        stats->numCowCopies++;
+    } else {
+        coreMap->UncacheText(frame);  // It is about to change.
+    }
+    entry->readOnly = false;
+    machine->GetMMU()->FlushHostCache();
+    coreMap->pagingLock->Release();
 }
 
 #endif
@@ -288,33 +529,168 @@ AddressSpace::LoadPage(int vpn) {
 unsigned
 AddressSpace::WriteToSwap(int vpn, uint32_t physAddr) {
     char *mainMemory = machine->GetMMU()->mainMemory;
-    int vAddr = VirtualPageAddress(vpn);
-    pageTable[vpn].valid = false;
 
-    unsigned resultado;
-    if(pageTable[vpn].dirty == false) {
-        resultado = numPages + 1; // Retorno especial - No es necesario escribirla en swap
-    } else {
-        resultado = swapFile->WriteAt(mainMemory + physAddr, PAGE_SIZE, vAddr);
+    // Invalidar entrada en la TLB, guardando antes sus bits `use` y `dirty`
+    #ifdef USE_TLB
+    tlbManager->Invalidate(this, vpn);
+    #endif
+    TranslationEntry *entry = pageTable->Get(vpn);
+    entry->valid = false;
+    machine->GetMMU()->FlushHostCache();
+
+    // Si no fue modificada, su contenido sigue estando donde se leyó: en el
+    // ejecutable o en el área de intercambio.
+    if (!entry->dirty) {
+        return 0;
     }
 
-    // Remover página de memoria
-    memset(mainMemory + physAddr, 0, PAGE_SIZE);
+    // The modified pages next to it in memory go along, and stay clean.
+    unsigned first = vpn - vpn % SWAP_CLUSTER;
+    unsigned end = first + SWAP_CLUSTER < numPages
+                   ? first + SWAP_CLUSTER : numPages;
+    unsigned low = vpn, high = vpn + 1;
+    while (high < end && IsDirty(high)) {
+        high++;
+    }
+    while (low > first && IsDirty(low - 1)) {
+        low--;
+    }
 
-    // Invalidar entrada en la TLB
-    for(unsigned i=0; i < TLB_SIZE; i++) {
-        if(machine->GetMMU()->tlb[i].virtualPage == (unsigned) vpn)
-            machine->GetMMU()->tlb[i].valid = false;
+    // Recién la primera vez que se escribe una página del bloque se le
+    // asigna un lugar.
+    unsigned cluster = FindCluster(vpn);
+    if (cluster == NO_SWAP_SLOT) {
+        cluster = swapArea->Allocate();
+        ASSERT(cluster != NO_SWAP_SLOT);  // El área está llena.
     }
 
-    return resultado;
+    unsigned count = high - low;
+    if (count == 1) {
+        entry->swapSlot = cluster + vpn % SWAP_CLUSTER;
+        swapArea->Write(entry->swapSlot, 1, mainMemory + physAddr);
+    } else {
+        char *buffer = new char [count * PAGE_SIZE];
+        for (unsigned i = low; i < high; i++) {
+            TranslationEntry *page = pageTable->Find(i);
+            unsigned frameAddr = i == (unsigned) vpn
+                                 ? physAddr : page->physicalPage * PAGE_SIZE;
+            memcpy(buffer + (i - low) * PAGE_SIZE, mainMemory + frameAddr,
+                   PAGE_SIZE);
+            page->dirty = false;
+            page->swapSlot = cluster + i % SWAP_CLUSTER;
+        }
+        swapArea->Write(cluster + low % SWAP_CLUSTER, count, buffer);
+        delete [] buffer;
+    }
+    stats->numSwapWritten += count;
+    return count * PAGE_SIZE;
 }
 
 int
 AddressSpace::ReadFromSwap(int vpn, uint32_t physAddr) {
-    int vAddr = VirtualPageAddress(vpn);
+    const TranslationEntry *entry = pageTable->Find(vpn);
+    ASSERT(entry != nullptr && entry->swapSlot != NO_SWAP_SLOT);
     char *mainMemory = machine->GetMMU()->mainMemory;
-    return swapFile->ReadAt(mainMemory + physAddr, PAGE_SIZE, vAddr);
+
+    // The pages next to it that are out too come along, as long as there
+    // are frames to spare for them.
+    unsigned first = vpn - vpn % SWAP_CLUSTER;
+    unsigned end = first + SWAP_CLUSTER < numPages
+                   ? first + SWAP_CLUSTER : numPages;
+    int frames[SWAP_CLUSTER];
+    frames[vpn % SWAP_CLUSTER] = physAddr / PAGE_SIZE;
+    unsigned low = vpn, high = vpn + 1;
+    while (high < end && IsSwappedOut(high)
+             && (frames[high % SWAP_CLUSTER]
+                   = coreMap->BookSpare(high, this)) != -1) {
+        high++;
+    }
+    while (low > first && IsSwappedOut(low - 1)
+             && (frames[(low - 1) % SWAP_CLUSTER]
+                   = coreMap->BookSpare(low - 1, this)) != -1) {
+        low--;
+    }
+
+    unsigned count = high - low;
+    if (count == 1) {
+        swapArea->Read(entry->swapSlot, 1, mainMemory + physAddr);
+    } else {
+        char *buffer = new char [count * PAGE_SIZE];
+        swapArea->Read(entry->swapSlot - (vpn - low), count, buffer);
+        for (unsigned i = low; i < high; i++) {
+            memcpy(mainMemory + frames[i % SWAP_CLUSTER] * PAGE_SIZE,
+                   buffer + (i - low) * PAGE_SIZE, PAGE_SIZE);
+            if (i == (unsigned) vpn) {
+                continue;  // Mapped by `LoadPage`.
+            }
+            TranslationEntry *page = pageTable->Find(i);
+            page->physicalPage = frames[i % SWAP_CLUSTER];
+            page->valid = true;
+            page->readOnly = false;
+            page->use = false;
+            page->dirty = false;
+        }
+        delete [] buffer;
+    }
+    stats->numSwapRead += count;
+    return count * PAGE_SIZE;
+}
+
+unsigned
+AddressSpace::FindCluster(unsigned vpn) const {
+    unsigned first = vpn - vpn % SWAP_CLUSTER;
+    for (unsigned i = first; i < first + SWAP_CLUSTER && i < numPages; i++) {
+        const TranslationEntry *page = pageTable->Find(i);
+        if (page != nullptr && page->swapSlot != NO_SWAP_SLOT) {
+            return page->swapSlot - i % SWAP_CLUSTER;
+        }
+    }
+    return NO_SWAP_SLOT;
+}
+
+bool
+AddressSpace::IsDirty(unsigned vpn) {
+    TranslationEntry *page = pageTable->Find(vpn);
+    if (page == nullptr || !page->valid) {
+        return false;
+    }
+    #ifdef USE_TLB
+    tlbManager->Clean(this, vpn);
+    #endif
+    return page->dirty;
+}
+
+bool
+AddressSpace::IsSwappedOut(unsigned vpn) const {
+    const TranslationEntry *page = pageTable->Find(vpn);
+    return page != nullptr && !page->valid && page->swapSlot != NO_SWAP_SLOT;
+}
+
+void
+AddressSpace::CopySwap(const AddressSpace *parent) {
+    char *buffer = nullptr;
+    for (unsigned first = 0; first < numPages; first += SWAP_CLUSTER) {
+        unsigned from = parent->FindCluster(first);
+        if (from == NO_SWAP_SLOT) {
+            continue;
+        }
+        unsigned to = swapArea->Allocate();
+        ASSERT(to != NO_SWAP_SLOT);  // El área está llena.
+
+        if (buffer == nullptr) {
+            buffer = new char [SWAP_CLUSTER * PAGE_SIZE];
+        }
+        swapArea->Read(from, SWAP_CLUSTER, buffer);
+        swapArea->Write(to, SWAP_CLUSTER, buffer);
+        for (unsigned i = first; i < first + SWAP_CLUSTER && i < numPages;
+             i++) {
+            const TranslationEntry *page = parent->pageTable->Find(i);
+            if (page != nullptr && page->swapSlot != NO_SWAP_SLOT) {
+                pageTable->Get(i)->swapSlot = to + i % SWAP_CLUSTER;
+            }
+        }
+    }
+    delete [] buffer;
 }
 
 #endif
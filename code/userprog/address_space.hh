@@ -15,15 +15,19 @@
 
 
 #include "filesys/file_system.hh"
+#include "machine/page_table.hh"
 #include "machine/translation_entry.hh"
 #include "machine/statistics.hh"
+#include "lib/bitmap.hh"
 #include "syscall.h"
 
 #include <stdint.h>
 
 
+class Semaphore;
+
+
 const unsigned USER_STACK_SIZE = 1024;  ///< Increase this as necessary!
-const unsigned MAX_SWAP_FILENAME = 8;
 
 
 class AddressSpace {
@@ -38,8 +42,17 @@ public:
     ///
     /// Parameters:
     /// * `executable_file` is the open file that corresponds to the
-    ///   program; it contains the object code to load into memory.
-    AddressSpace(OpenFile *executable_file, SpaceId spaceId);
+    ///   program; it contains the object code to load into memory.  Under
+    ///   *DEMAND_LOADING*, the pages of code are shared with the other
+    ///   address spaces running the same file.
+    AddressSpace(OpenFile *executable_file);
+
+    /// Create a copy of `parent`, for `Fork`.
+    ///
+    /// Under *DEMAND_LOADING*, the pages that `parent` has in memory are
+    /// not copied: both map them read-only, until either one writes to
+    /// them (see `CopyOnWrite`).  Those it has in swap are copied there.
+    AddressSpace(AddressSpace *parent);
 
     /// De-allocate an address space.
     ~AddressSpace();
@@ -52,16 +65,48 @@ public:
     void SaveState();
     void RestoreState();
 
-    TranslationEntry *pageTable;
+    /// Return the number of pages in the virtual address space.
+    unsigned GetNumPages() const;
+
+    PageTable *pageTable;
 #ifdef VMEM
 
 public:
     //Tambien funciona en swap
     TranslationEntry LoadPage(int vpn);
 
+#ifdef DEMAND_LOADING
+    /// Give virtual page `vpn`, that was written to while read-only, shared
+    /// with other address spaces, a frame of its own, with a copy of it; or
+    /// let it be written, if no other one shares it any more.  A page of
+    /// zeros gets a frame of zeros.
+    void CopyOnWrite(unsigned vpn);
+#endif
+
 private:
     OpenFile *exec_file;
 
+    /// Identity of `exec_file`, that the pages of code are shared by.
+    unsigned long long execId;
+
+    /// Number of address spaces, forked from one another, that load their
+    /// pages from `exec_file`; the last one closes it.
+    unsigned *execFileUsers;
+
+#ifdef DEMAND_LOADING
+    /// Virtual pages that hold code and nothing else, from the first one up
+    /// to the end one, excluded.  They are mapped read-only, and shared.
+    unsigned firstTextPage;
+    unsigned endTextPage;
+
+    /// Return whether virtual page `vpn` is to be loaded as shared text.
+    bool IsText(unsigned vpn) const;
+
+    /// First virtual page past the code and initialized data: the pages
+    /// from it on hold zeros until written to.
+    unsigned firstZeroPage;
+#endif
+
     void ReadPage(char *mainMemory, uint32_t virtualAddr, int physPageAddr);
 
     //Funciones de swap
@@ -72,16 +117,71 @@ private:
     /// Number of pages in the virtual address space.
     unsigned numPages;
 
+#ifdef VMEM
+
+public:
+    /// Frame accounting, kept up to date by the core map.
+
+    /// Number of frames holding pages of this address space.
+    unsigned numResident;
+
+    /// Number of page faults of this address space.
+    unsigned long numPageFaults;
+
+#ifdef PFF
+    /// Most frames that this address space may hold; while it is
+    /// suspended, those it gets when resumed.
+    unsigned quota;
+
+    /// Time of the last page fault of this address space.
+    unsigned long lastFault;
+
+    /// Time this address space was created at.
+    unsigned long admittedAt;
+
+    /// Time this address space was last suspended at.
+    unsigned long suspendedAt;
+
+    /// Whether it was suspended and has not waited to be resumed yet.
+    bool swappedOut;
+
+    /// Signaled when this address space is resumed.
+    Semaphore *resume;
+#endif
+#endif
+
 #ifdef SWAP
 
 private:
-    char *swapFileName;
-    OpenFile *swapFile;
+    /// Return the first slot of the cluster of the swap area that holds the
+    /// block of virtual page `vpn`, or `NO_SWAP_SLOT` if it has none yet.
+    unsigned FindCluster(unsigned vpn) const;
+
+    /// Return whether virtual page `vpn` is in memory and was modified,
+    /// copying its bits from the TLB first.
+    bool IsDirty(unsigned vpn);
+
+    /// Return whether virtual page `vpn` is out of memory, in the swap
+    /// area.
+    bool IsSwappedOut(unsigned vpn) const;
+
+    /// Copy the clusters of the swap area of `parent` into new ones, for
+    /// the pages that it has there.
+    void CopySwap(const AddressSpace *parent);
 
 public:
-    // Documentar
+    /// Take virtual page `vpn` out of the frame at `physAddr`, writing it
+    /// to its slot of the swap area if it was modified, together with the
+    /// modified pages next to it in memory.
+    ///
+    /// Return the number of bytes written.
     unsigned WriteToSwap(int vpn, uint32_t physAddr);
 
+    /// Read virtual page `vpn` from the swap area into the frame at
+    /// `physAddr`, together with the pages next to it that are out too, if
+    /// there are frames to spare for them.
+    ///
+    /// Return the number of bytes read.
     int ReadFromSwap(int vpn, uint32_t physAddr);
 #endif
 
@@ -133,7 +133,7 @@ CommandDump(char **args, void *extra)
         return DCM::RUN_RESULT_STAY;
     }
 
-    int rv = fwrite(machine->GetMMU()->mainMemory, 1, MEMORY_SIZE, f);
+    size_t rv = fwrite(machine->GetMMU()->mainMemory, 1, MEMORY_SIZE, f);
     if (rv != MEMORY_SIZE) {
         fprintf(stderr, "ERROR: write to file `%s` did not succeed.\n",
                 path);
@@ -64,6 +64,20 @@ static void RunUserProgram(void *_argv) {
 }
 
 
+/// Run a copy of a user program, made by `Fork`, from the user registers
+/// in `_registers`.
+static void RunForkedProgram(void *_registers) {
+    int *registers = (int *) _registers;
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, registers[i]);
+    }
+    delete [] registers;
+    currentThread->space->RestoreState();
+
+    machine->Run();  // Jump back to the user program.
+}
+
+
 static void
 IncrementPC()
 {
@@ -77,6 +91,15 @@ IncrementPC()
     machine->WriteRegister(NEXT_PC_REG, pc);
 }
 
+/// Charge the time of a memory system call that went over `byteCount`
+/// bytes, at `memoryOpTicks` ticks per word.
+static void
+ChargeMemoryOp(unsigned byteCount)
+{
+    interrupt->AdvanceSystemTicks(memoryOpTicks
+                                  * DivRoundUp(byteCount, 4u));
+}
+
 /// Do some default behavior for an unexpected exception.
 ///
 /// NOTE: this function is meant specifically for unexpected exceptions.  If
@@ -168,6 +191,9 @@ SyscallHandler(ExceptionType _et)
             int returnValue = machine->ReadRegister(4);
 
             DEBUG('a', "Exited with status %d\n", returnValue);
+            if (haltStatus == 0) {
+                haltStatus = returnValue;
+            }
             currentThread->Finish(returnValue);
 
             break;
@@ -355,7 +381,7 @@ SyscallHandler(ExceptionType _et)
             }
 
             Thread * thread = new Thread(filename, enableJoin, 0);
-            AddressSpace *space = new AddressSpace(executable, thread->spaceId);
+            AddressSpace *space = new AddressSpace(executable);
 
             // Set address space
             thread->space = space;
@@ -365,7 +391,9 @@ SyscallHandler(ExceptionType _et)
             else
                 thread->Fork(RunUserProgram, SaveArgs(argsAddr));
 
-            delete executable;
+#ifndef VMEM
+            delete executable;  // Owned by the address space under *VMEM*.
+#endif
 
             SpaceId spaceId = thread->GetSpaceId();
             machine->WriteRegister(2, spaceId);
@@ -373,6 +401,29 @@ SyscallHandler(ExceptionType _et)
             break;
         }
 
+        case SC_FORK: {
+            int enableJoin = machine->ReadRegister(4);
+
+            DEBUG('e', "`Fork` requested.\n");
+
+            Thread *thread = new Thread(currentThread->GetName(), enableJoin, 0);
+            thread->space = new AddressSpace(currentThread->space);
+
+            // The copy goes on after the system call too, where it gets 0.
+            int *registers = new int [NUM_TOTAL_REGS];
+            for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+                registers[i] = machine->ReadRegister(i);
+            }
+            registers[2] = 0;
+            registers[PREV_PC_REG] = registers[PC_REG];
+            registers[PC_REG] = registers[NEXT_PC_REG];
+            registers[NEXT_PC_REG] += 4;
+            thread->Fork(RunForkedProgram, registers);
+
+            machine->WriteRegister(2, thread->GetSpaceId());
+            break;
+        }
+
         case SC_JOIN: {
             SpaceId spaceId = machine->ReadRegister(4);
 
@@ -402,6 +453,72 @@ SyscallHandler(ExceptionType _et)
             break;
         }
 
+        case SC_MEM_COPY: {
+            int dstAddr = machine->ReadRegister(4);
+            int srcAddr = machine->ReadRegister(5);
+            unsigned size = machine->ReadRegister(6);
+
+            DEBUG('e', "`MemCopy` requested from 0x%X to 0x%X, %u bytes.\n",
+                  srcAddr, dstAddr, size);
+            if (!CopyUserMemory(dstAddr, srcAddr, size)) {
+                DEBUG('e', "Error: invalid address.\n");
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            ChargeMemoryOp(size);
+            machine->WriteRegister(2, 0);
+            break;
+        }
+
+        case SC_MEM_SET: {
+            int dstAddr = machine->ReadRegister(4);
+            int value = machine->ReadRegister(5);
+            unsigned size = machine->ReadRegister(6);
+
+            DEBUG('e', "`MemSet` requested at 0x%X, %u bytes.\n",
+                  dstAddr, size);
+            if (!SetUserMemory(dstAddr, value, size)) {
+                DEBUG('e', "Error: invalid address.\n");
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            ChargeMemoryOp(size);
+            machine->WriteRegister(2, 0);
+            break;
+        }
+
+        case SC_STR_LEN: {
+            int stringAddr = machine->ReadRegister(4);
+            unsigned length;
+
+            DEBUG('e', "`StrLen` requested at 0x%X.\n", stringAddr);
+            if (!UserStringLength(stringAddr, &length)) {
+                DEBUG('e', "Error: invalid address.\n");
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            ChargeMemoryOp(length + 1);
+            machine->WriteRegister(2, length);
+            break;
+        }
+
+        case SC_MEM_COMPARE: {
+            int addr1 = machine->ReadRegister(4);
+            int addr2 = machine->ReadRegister(5);
+            unsigned size = machine->ReadRegister(6);
+            int result;
+
+            DEBUG('e', "`MemCompare` requested at 0x%X and 0x%X, %u bytes.\n",
+                  addr1, addr2, size);
+            if (!CompareUserMemory(addr1, addr2, size, &result)) {
+                DEBUG('e', "Error: invalid address.\n");
+                result = 0;
+            }
+            ChargeMemoryOp(size);
+            machine->WriteRegister(2, result);
+            break;
+        }
+
         default:
             fprintf(stderr, "Unexpected system call: id %d.\n", scid);
             ASSERT(false);
@@ -411,60 +528,51 @@ SyscallHandler(ExceptionType _et)
     IncrementPC();
 }
 
-int getVPN(int vaddr){
-    return vaddr / PAGE_SIZE;
-}
-
-void savePageState(TranslationEntry tlbEntry){
-    TranslationEntry *pageTable = currentThread->space->pageTable;
-    int vpn = tlbEntry.virtualPage;
-
-    if (pageTable[vpn].valid) {
-        pageTable[vpn].dirty = tlbEntry.dirty;
-        pageTable[vpn].use = tlbEntry.use;
-    } 
-} 
-
-
 // Ejercicio 1c plancha 4
 // Rellena la TLB con una entrada válida para la página que falló
 static void
-PageFaultHandler(ExceptionType _et) {
-    static int i = 0;
-    static int ioffset = i % TLB_SIZE;
-    int vaddr = machine->ReadRegister(BAD_VADDR_REG);
-    int vpn = getVPN(vaddr);
-
-    // Incrementamos en 1 la cantidad de page faults
-    stats->numPageFaults++;
-    
-    // Se copia la información de la TLB a la tabla de páginas correspondiente
-    if(machine->GetMMU()->tlb[ioffset].valid){
-        savePageState(machine->GetMMU()->tlb[ioffset]);
+PageFaultHandler(ExceptionType et)
+{
+    unsigned vaddr = machine->ReadRegister(BAD_VADDR_REG);
+    unsigned vpn = vaddr / PAGE_SIZE;
+    AddressSpace *space = currentThread->space;
+
+    if (vpn >= space->GetNumPages()) {
+        DEBUG('e', "Error: address 0x%X out of the address space.\n", vaddr);
+        currentThread->Finish(et);
     }
-    
-    if(!currentThread->space->pageTable[vpn].valid){
+
+#ifdef USE_TLB
+    const TranslationEntry *entry = space->pageTable->Find(vpn);
+    if (entry == nullptr || !entry->valid) {
         // Ejercicio 3 plancha 4
         // Entrada válida que todavía no está cargada
-        // En demand loading se invalidan todas las entradas primero
-        #ifdef DEMAND_LOADING
-        machine->GetMMU()->tlb[ioffset] = currentThread->space->LoadPage(vpn);
-        #endif
-    }
-    else {
-        machine->GetMMU()->tlb[ioffset] = currentThread->space->pageTable[vpn];
+#ifdef DEMAND_LOADING
+        stats->numPageFaults++;
+        space->LoadPage(vpn);
+#else
+        DefaultHandler(et);
+#endif
     }
+    tlbManager->Load(*space->pageTable->Find(vpn));
+#else
+    DefaultHandler(et);
+#endif
 
-    // Política FIFO para reemplazo de páginas
-    i++;
-
-    // IncrementPC(); La instrucción no se terminó de ejecutar, generó un fallo y debe continuar
+    // La instrucción no se terminó de ejecutar, generó un fallo y se vuelve
+    // a intentar al retornar.
 }
 
 // Ejercicio 1d plancha 4
 static void
 ReadOnlyExceptionHandler(ExceptionType et){
+#ifdef DEMAND_LOADING
+    // Pages are only read-only while shared, after a `Fork` or as code.
+    unsigned vaddr = machine->ReadRegister(BAD_VADDR_REG);
+    currentThread->space->CopyOnWrite(vaddr / PAGE_SIZE);
+#else
     currentThread->Finish(et);
+#endif
 }
 
 /// By default, only system calls have their own handler.  All other
@@ -82,6 +82,12 @@ Executable::GetInitDataAddr() const
     return header.initData.virtualAddr;
 }
 
+uint32_t
+Executable::GetUninitDataAddr() const
+{
+    return header.uninitData.virtualAddr;
+}
+
 int
 Executable::ReadCodeBlock(char *dest, uint32_t size, uint32_t offset)
 {
@@ -32,10 +32,13 @@ StartProcess(const char *filename)
         return;
     }
 
-    AddressSpace *space = new AddressSpace(executable, currentThread->spaceId);
+    AddressSpace *space = new AddressSpace(executable);
     currentThread->space = space;
 
-    delete executable;
+#ifndef VMEM
+    delete executable;  // Under *VMEM*, the address space keeps it open
+                        // to load pages on demand.
+#endif
 
     space->InitRegisters();  // Set the initial register values.
     space->RestoreState();   // Load page table register.
@@ -50,9 +53,9 @@ StartProcess(const char *filename)
 /// Threads making I/O requests wait on a `Semaphore` to delay until the I/O
 /// completes.
 
-static Console   *console;
-static Semaphore *readAvail;
-static Semaphore *writeDone;
+static thread_local Console   *console;
+static thread_local Semaphore *readAvail;
+static thread_local Semaphore *writeDone;
 
 /// Console interrupt handlers.
 ///
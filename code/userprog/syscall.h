@@ -32,6 +32,10 @@
 #define SC_READ    14
 #define SC_WRITE   15
 #define SC_PRINT   16
+#define SC_MEM_COPY    17
+#define SC_MEM_SET     18
+#define SC_STR_LEN     19
+#define SC_MEM_COMPARE 20
 
 
 #ifndef IN_ASM
@@ -49,7 +53,7 @@
 void Halt();
 
 
-/// Address space control operations: `Exit`, `Exec`, and `Join`.
+/// Address space control operations: `Exit`, `Exec`, `Fork` and `Join`.
 
 /// This user program is done (`status = 0` means exited normally).
 void Exit(int status);
@@ -61,18 +65,20 @@ typedef int SpaceId;
 /// address space identifier.
 SpaceId Exec(char *name, char **args, int enableJoin);
 
+/// Run a copy of the running user program, in an address space of its
+/// own, that goes on from the return of this call; it can be joined if
+/// `enableJoin` is set.  It starts with just the console open.
+///
+/// Return the address space identifier of the copy, or 0 in the copy.
+SpaceId Fork(int enableJoin);
+
 /// Only return once the the user program `id` has finished.
 ///
 /// Return the exit status.
 int Join(SpaceId id);
 
 
-/// User-level thread operations: `Fork` and `Yield`.  To allow multiple
-/// threads to run within a user program.
-
-/// Fork a thread to run a procedure (`func`) in the *same* address space as
-/// the current thread.
-int Fork(void (*func)(void));
+/// User-level thread operations: `Yield`.
 
 /// Yield the CPU to another runnable thread, whether in this address space
 /// or not.
@@ -83,6 +89,31 @@ void Yield();
 void Print();
 
 
+/// Memory operations: `MemCopy`, `MemSet`, `StrLen`, `MemCompare`.
+///
+/// These do what `memcpy`, `memset`, `strlen` and `memcmp` do, but the
+/// kernel does them natively, much faster than a loop of user instructions.
+/// Each one is charged a number of ticks per word it goes over (see the
+/// `-mc` flag).
+
+/// Copy `size` bytes from `src` to `dst`, which must not overlap.
+///
+/// Return 0, or -1 if some address is invalid.
+int MemCopy(void *dst, const void *src, unsigned size);
+
+/// Set `size` bytes at `dst` to `value`.
+///
+/// Return 0, or -1 if some address is invalid.
+int MemSet(void *dst, int value, unsigned size);
+
+/// Return the length of the string `s`, or -1 if some address is invalid.
+int StrLen(const char *s);
+
+/// Compare `size` bytes at `s1` and `s2`, returning a number less than,
+/// equal to, or greater than 0, as `memcmp` does.
+int MemCompare(const void *s1, const void *s2, unsigned size);
+
+
 /// File system operations: `Create`, `Open`, `Read`, `Write`, `Close`.
 ///
 /// These functions are patterned after UNIX -- files represent both files
@@ -4,16 +4,18 @@
 
 #include "transfer.hh"
 #include "lib/utility.hh"
+#include "machine/decode_cache.hh"
 #include "threads/system.hh"
 
+#include <string.h>
+
 // MAX_PAGE_FAULTS está definido en machine
 
 bool SafeReadMem(int userAddress, unsigned size, int* buffer) {
-    if (machine->ReadMem(userAddress++, 1, buffer))
-        return true;
-
-    for (int i = 0; i < MAX_PAGE_FAULTS; i++) {
-        if (!machine->ReadMem(userAddress++, 1, buffer))
+    // Every failed access lets the kernel service the fault; then the same
+    // address is tried again.
+    for (int i = 0; i <= MAX_PAGE_FAULTS; i++) {
+        if (machine->ReadMem(userAddress, size, buffer))
             return true;
     }
 
@@ -21,11 +23,10 @@ bool SafeReadMem(int userAddress, unsigned size, int* buffer) {
 }
 
 bool SafeWriteMem(int userAddress, unsigned size, int buffer) {
-    if (machine->WriteMem(userAddress++, 1, buffer))
-        return true;
-
-    for (int i = 0; i < MAX_PAGE_FAULTS; i++) {
-        if (!machine->WriteMem(userAddress++, 1, buffer))
+    // Every failed access lets the kernel service the fault; then the same
+    // address is tried again.
+    for (int i = 0; i <= MAX_PAGE_FAULTS; i++) {
+        if (machine->WriteMem(userAddress, size, buffer))
             return true;
     }
 
@@ -41,7 +42,7 @@ void ReadBufferFromUser(int userAddress, char *outBuffer, unsigned byteCount) {
     for (unsigned count = 0; count < byteCount; count++) {
         // Ejercicio 1b - Plancha 4. Tambien se reemplazan los llamados en args.cc
         ASSERT(SafeReadMem(userAddress++, 1, &temp));
-        *outBuffer = (unsigned char)temp;
+        *outBuffer++ = (unsigned char)temp;
     }
 }
 
@@ -55,10 +56,7 @@ bool ReadStringFromUser(int userAddress, char *outString, unsigned maxByteCount)
     {
         int temp;
         count++;
-        int i;
-        for(i = 0; (i<MAX_PAGE_FAULTS) &&  (!(SafeReadMem(userAddress++, 1, &temp))); i++);
-        userAddress++;
-        ASSERT(i < MAX_PAGE_FAULTS);
+        ASSERT(SafeReadMem(userAddress++, 1, &temp));
         *outString = (unsigned char) temp;
     } while (*outString++ != '\0' && count < maxByteCount);
 
@@ -71,7 +69,7 @@ void WriteBufferToUser(const char *buffer, int userAddress, unsigned byteCount)
     ASSERT(byteCount != 0);
 
     for (unsigned count = 0; count < byteCount; count++) {
-        ASSERT(SafeWriteMem(userAddress++, 1, (int)*buffer));
+        ASSERT(SafeWriteMem(userAddress++, 1, (int)*buffer++));
     }
 }
 
@@ -84,3 +82,156 @@ void WriteStringToUser(const char *string, int userAddress) {
         ASSERT(SafeWriteMem(userAddress++, 1, (int)*string));
     } while (*string++ != '\0');
 }
+
+/// Return where the byte at `userAddress` is in the main memory, for
+/// reading it or `writing` it, servicing the page faults it causes.  Store
+/// in `*available` how many bytes of its page there are from it on.
+///
+/// Return null if it cannot be translated.
+static char *
+UserToHost(int userAddress, bool writing, unsigned *available)
+{
+    MMU *mmu = machine->GetMMU();
+    for (int i = 0; i <= MAX_PAGE_FAULTS; i++) {
+        unsigned physAddr;
+        ExceptionType e = mmu->TranslateAccess(userAddress, 1, writing,
+                                               &physAddr);
+        if (e == NO_EXCEPTION) {
+            if (writing) {
+                // Whatever was decoded from the frame is about to change.
+                mmu->GetDecodeCache()->InvalidateFrame(physAddr / PAGE_SIZE);
+            }
+            *available = PAGE_SIZE - physAddr % PAGE_SIZE;
+            return &mmu->mainMemory[physAddr];
+        }
+        machine->RaiseException(e, userAddress);  // Let the kernel handle it.
+    }
+    return nullptr;
+}
+
+/// Return whether `userAddress` is still at `host` in the main memory, for
+/// reading it or `writing` it, without servicing any page fault.
+static bool
+IsMappedTo(int userAddress, bool writing, const char *host)
+{
+    MMU *mmu = machine->GetMMU();
+    unsigned physAddr;
+    return mmu->TranslateAccess(userAddress, 1, writing, &physAddr)
+             == NO_EXCEPTION
+           && &mmu->mainMemory[physAddr] == host;
+}
+
+/// Like `UserToHost`, for two addresses at once, only the first of which
+/// may be written.  `*available` is the number of bytes that can be
+/// accessed from both before reaching the end of either page.
+static bool
+UserPairToHost(int address1, bool writing, int address2,
+               char **host1, char **host2, unsigned *available)
+{
+    for (int i = 0; i <= MAX_PAGE_FAULTS; i++) {
+        unsigned available1, available2;
+        *host1 = UserToHost(address1, writing, &available1);
+        *host2 = *host1 == nullptr
+                 ? nullptr : UserToHost(address2, false, &available2);
+        if (*host2 == nullptr) {
+            return false;
+        }
+        // Bringing in the second page may have evicted the first one, and
+        // even put the second one in its frame.  Bringing the first one
+        // back could evict the second one in turn, so it is only checked.
+        if (IsMappedTo(address1, writing, *host1)) {
+            *available = available1 < available2 ? available1 : available2;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+CopyUserMemory(int dstAddress, int srcAddress, unsigned byteCount)
+{
+    while (byteCount > 0) {
+        char *dst, *src;
+        unsigned n;
+        if (!UserPairToHost(dstAddress, true, srcAddress, &dst, &src, &n)) {
+            return false;
+        }
+        if (n > byteCount) {
+            n = byteCount;
+        }
+        memmove(dst, src, n);
+        dstAddress += n;
+        srcAddress += n;
+        byteCount  -= n;
+    }
+    return true;
+}
+
+bool
+SetUserMemory(int userAddress, int value, unsigned byteCount)
+{
+    while (byteCount > 0) {
+        unsigned n;
+        char *dst = UserToHost(userAddress, true, &n);
+        if (dst == nullptr) {
+            return false;
+        }
+        if (n > byteCount) {
+            n = byteCount;
+        }
+        memset(dst, value, n);
+        userAddress += n;
+        byteCount   -= n;
+    }
+    return true;
+}
+
+bool
+UserStringLength(int userAddress, unsigned *length)
+{
+    ASSERT(length != nullptr);
+
+    *length = 0;
+    for (;;) {
+        unsigned n;
+        const char *s = UserToHost(userAddress, false, &n);
+        if (s == nullptr) {
+            return false;
+        }
+        const char *end = (const char *) memchr(s, '\0', n);
+        if (end != nullptr) {
+            *length += end - s;
+            return true;
+        }
+        userAddress += n;
+        *length     += n;
+    }
+}
+
+bool
+CompareUserMemory(int address1, int address2, unsigned byteCount,
+                  int *result)
+{
+    ASSERT(result != nullptr);
+
+    *result = 0;
+    while (byteCount > 0) {
+        char *host1, *host2;
+        unsigned n;
+        if (!UserPairToHost(address1, false, address2,
+                            &host1, &host2, &n)) {
+            return false;
+        }
+        if (n > byteCount) {
+            n = byteCount;
+        }
+        *result = memcmp(host1, host2, n);
+        if (*result != 0) {
+            return true;
+        }
+        address1  += n;
+        address2  += n;
+        byteCount -= n;
+    }
+    return true;
+}
@@ -26,5 +26,26 @@ void WriteBufferToUser(const char *buffer, int userAddress,
 /// Copy a C string from host to virtual machine.
 void WriteStringToUser(const char *string, int userAddress);
 
+/// Native versions of the C memory and string routines, working on user
+/// memory in place, a page at a time, instead of a byte at a time.  Page
+/// faults are serviced as they happen.
+///
+/// All of them return false if some address could not be translated.
+
+/// Copy `byteCount` bytes from `srcAddress` to `dstAddress`; the areas
+/// must not overlap.
+bool CopyUserMemory(int dstAddress, int srcAddress, unsigned byteCount);
+
+/// Set `byteCount` bytes at `userAddress` to `value`.
+bool SetUserMemory(int userAddress, int value, unsigned byteCount);
+
+/// Store the length of the C string at `userAddress` in `*length`.
+bool UserStringLength(int userAddress, unsigned *length);
+
+/// Compare `byteCount` bytes at `address1` and `address2` as `memcmp`
+/// does, storing the result in `*result`.
+bool CompareUserMemory(int address1, int address2, unsigned byteCount,
+                       int *result);
+
 
 #endif
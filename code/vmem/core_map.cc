@@ -1,6 +1,30 @@
 #include "core_map.hh"
-#include <stdlib.h>
-#include <time.h>
+#include "threads/lock.hh"
+#include "threads/semaphore.hh"
+#include "threads/system.hh"
+#include "machine/system_dep.hh"
+
+#include <string.h>
+
+#ifdef DEMAND_LOADING
+static void
+Zeroer(void *map) {
+    ((CoreMap *) map)->ZeroFree();
+}
+#endif
+
+#ifdef PAGEOUT_DAEMON
+static void
+PageoutDaemon(void *map) {
+    ((CoreMap *) map)->Pageout();
+}
+
+// Percentage `percent` of the frames, rounded up.
+static unsigned
+Watermark(unsigned percent) {
+    return DivRoundUp(NUM_PHYS_PAGES * percent, 100u);
+}
+#endif
 
 // Ejercicio 4a plancha 4
 
@@ -9,15 +33,78 @@ CoreMap::CoreMap(){
     ownerAddSpaces = new AddressSpace *[NUM_PHYS_PAGES];
     virtualPageNum = new unsigned int [NUM_PHYS_PAGES];
     victimStack = new List<int>;
+    refCount = new unsigned [NUM_PHYS_PAGES];
+    textEntries = new TextEntry [NUM_PHYS_PAGES];
+    textBuckets = new int [NUM_PHYS_PAGES];
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        ownerAddSpaces[i] = nullptr;
+        refCount[i] = 0;
+        textEntries[i].cached = false;
+        textBuckets[i] = -1;
+    }
+    spaces = new Table<AddressSpace *>;
+    pagingLock = new Lock("paging");
+
+    zeroed = new bool [NUM_PHYS_PAGES];
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        zeroed[i] = false;
+    }
+    zeroWakeUp = new Semaphore("zeroer", 0);
+    zeroerAwake = false;
+    zeroFrame = 0;
+#ifdef DEMAND_LOADING
+    // The frame of zeros is never handed out.  Other frames may hold what
+    // a snapshot left in them, so they are zeroed in the background first.
+    zeroFrame = pageMap->Find();
+    memset(machine->GetMMU()->mainMemory + zeroFrame * PAGE_SIZE, 0,
+           PAGE_SIZE);
+#endif
 
     // Ejercicio 5b plancha 4
     #ifdef PRPOLICY_LRU
       bitsReferencia = new unsigned [NUM_PHYS_PAGES];
+      for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+          bitsReferencia[i] = 0;
+      }
     #endif
 
     #ifdef PRPOLICY_FIFO
-        unsigned victimPointer = 0;
+        victimPointer = 0;
+    #endif
+
+    #ifdef PRPOLICY_CLOCK
+        clockHand = 0;
     #endif
+
+    #ifdef PFF
+        suspended = new List<AddressSpace *>;
+        committed = 0;
+    #endif
+
+    #ifdef PAGEOUT_DAEMON
+        lowWatermark  = Watermark(PAGEOUT_LOW_PERCENT);
+        highWatermark = Watermark(PAGEOUT_HIGH_PERCENT);
+        if (highWatermark <= lowWatermark && lowWatermark < NUM_PHYS_PAGES) {
+            highWatermark = lowWatermark + 1;
+        }
+        pageoutWakeUp = new Semaphore("pageout", 0);
+        pageoutAwake = false;
+        formerOwners = new AddressSpace *[NUM_PHYS_PAGES];
+        for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+            formerOwners[i] = nullptr;
+        }
+
+        // It runs along user programs, at their priority.
+        Thread *daemon = new Thread("pageout", false, 0);
+        daemon->Fork(PageoutDaemon, this);
+    #endif
+
+#ifdef DEMAND_LOADING
+    // Last, since it may run before the constructor returns.
+    Thread *zeroer = new Thread("zeroer", false, 0);
+    zeroer->Fork(Zeroer, this);
+    WakeZeroer();
+#endif
 }
 
 CoreMap::~CoreMap(){
@@ -25,15 +112,47 @@ CoreMap::~CoreMap(){
     delete [] ownerAddSpaces;
     delete [] virtualPageNum;
     delete victimStack;
+    delete [] refCount;
+    delete [] textEntries;
+    delete [] textBuckets;
+    delete [] zeroed;
+    delete zeroWakeUp;
+    delete spaces;
+    delete pagingLock;
+    #ifdef PFF
+      delete suspended;
+    #endif
+    #ifdef PAGEOUT_DAEMON
+      delete pageoutWakeUp;
+      delete [] formerOwners;
+    #endif
     #ifdef PRPOLICY_LRU
-      delete bitsReferencia;
+      delete [] bitsReferencia;
     #endif
 }
 
 int
-CoreMap::BookPage(unsigned int vpn, AddressSpace *space){
+CoreMap::BookPage(unsigned int vpn, AddressSpace *space, bool zero){
     DEBUG('m',"FindPage start\n");
-    int phyPage = pageMap->Find();
+    space->numPageFaults++;
+
+    int phyPage = -1;
+    #ifdef PFF
+    AdjustQuota(space);  // May suspend the current thread for a while.
+    if (space->numResident < space->quota)
+    #endif
+    {
+        for (unsigned i = 0; zero && i < NUM_PHYS_PAGES; i++) {
+            if (zeroed[i]) {
+                pageMap->Mark(i);
+                phyPage = i;
+                break;
+            }
+        }
+        if (phyPage == -1) {
+            phyPage = pageMap->Find();
+        }
+    }
 
     // Ejercicio 5b plancha 4
     #ifdef PRPOLICY_LRU
@@ -42,32 +161,81 @@ CoreMap::BookPage(unsigned int vpn, AddressSpace *space){
 
     #ifdef SWAP
     if(phyPage == -1){
-        phyPage = PickVictim();
+        phyPage = PickVictim(space);
         DEBUG('m',"Next victim: %d page\n", phyPage);
    
-        int n = ownerAddSpaces[phyPage]->WriteToSwap(virtualPageNum[phyPage], phyPage * PAGE_SIZE);
-        // if (n == NUM_PHYS_PAGES + 1)
-        //   stats->numSwapWritten++;
-        // else
-        //   DEBUG('m',"La página no se pudo escribir en el swap\n");
+        PageOut(phyPage);
+        stats->numFaultEvictions++;
     }
     #endif
 
+  // The frame is about to receive a new page.
+  machine->GetMMU()->InvalidateFrame(phyPage);
+  #ifdef PAGEOUT_DAEMON
+  formerOwners[phyPage] = nullptr;
+  #endif
+
   ownerAddSpaces[phyPage] = space;
   virtualPageNum[phyPage] = vpn;
+  refCount[phyPage] = 1;
+  UncacheText(phyPage);
+  if (zero && !zeroed[phyPage]) {
+      memset(machine->GetMMU()->mainMemory + phyPage * PAGE_SIZE, 0,
+             PAGE_SIZE);
+      stats->numZeroFills++;
+  }
+  zeroed[phyPage] = false;
+  space->numResident++;
+
+  #ifdef PAGEOUT_DAEMON
+  // Only now, since waking the daemon up may let other threads run.
+  if (pageMap->CountClear() < lowWatermark && !pageoutAwake
+        && HasSurplus()) {
+      pageoutAwake = true;
+      pageoutWakeUp->V();
+  }
+  #endif
 
   return phyPage;
 }
 
 void
 CoreMap::ReleasePages(AddressSpace *addressSpace) {
+    // Some page of it may be on its way out.
+    pagingLock->Acquire();
     for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
-        if(ownerAddSpaces[i] == addressSpace) {
+        if (ownerAddSpaces[i] != nullptr && refCount[i] > 1
+              && Maps(i, addressSpace)) {
+          Unshare(i, addressSpace);  // The others keep it.
+        } else if(ownerAddSpaces[i] == addressSpace) {
           pageMap->Clear(i);
+          machine->GetMMU()->InvalidateFrame(i);
           victimStack->Remove(i);
           ownerAddSpaces[i] = nullptr;
         }
+        #ifdef PAGEOUT_DAEMON
+        if (formerOwners[i] == addressSpace) {
+          formerOwners[i] = nullptr;
+        }
+        #endif
     }
+    addressSpace->numResident = 0;
+    WakeZeroer();
+    for (unsigned i = 0; i < Table<AddressSpace *>::SIZE; i++) {
+        if (spaces->HasKey(i) && spaces->Get(i) == addressSpace) {
+            spaces->Remove(i);
+        }
+    }
+
+    #ifdef PFF
+    if (suspended->Has(addressSpace)) {
+        suspended->Remove(addressSpace);  // It never got to wait.
+    } else {
+        committed -= addressSpace->quota;
+    }
+    ResumeSuspended();
+    #endif
+    pagingLock->Release();
 }
 
 unsigned
@@ -75,17 +243,189 @@ CoreMap::CountClear() {
   return pageMap->CountClear();
 }
 
+#ifdef SWAP
+int
+CoreMap::BookSpare(unsigned vpn, AddressSpace *space) {
+    // Nothing is taken out of memory for it, nor out of the quota.
+    #ifdef PFF
+    if (space->numResident >= space->quota) {
+        return -1;
+    }
+    #endif
+    #ifdef PAGEOUT_DAEMON
+    if (pageMap->CountClear() <= lowWatermark) {
+        return -1;
+    }
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        if (formerOwners[i] == space && virtualPageNum[i] == vpn) {
+            return -1;  // It is reclaimed at its own page fault.
+        }
+    }
+    #endif
+    int frame = pageMap->Find();
+    if (frame == -1) {
+        return -1;
+    }
+
+    machine->GetMMU()->InvalidateFrame(frame);
+    #ifdef PAGEOUT_DAEMON
+    formerOwners[frame] = nullptr;
+    #endif
+    ownerAddSpaces[frame] = space;
+    virtualPageNum[frame] = vpn;
+    refCount[frame] = 1;
+    UncacheText(frame);
+    zeroed[frame] = false;
+    space->numResident++;
+    return frame;
+}
+#endif
+
+void
+CoreMap::AddSpace(AddressSpace *space) {
+    ASSERT(spaces->Add(space) != -1);
+}
+
+void
+CoreMap::Share(unsigned frame, AddressSpace *space) {
+    ASSERT(ownerAddSpaces[frame] != nullptr && ownerAddSpaces[frame] != space);
+    refCount[frame]++;
+}
+
+bool
+CoreMap::Unshare(unsigned frame, AddressSpace *space) {
+    if (refCount[frame] == 1) {
+        ASSERT(ownerAddSpaces[frame] == space);
+        return false;
+    }
+
+    refCount[frame]--;
+    if (ownerAddSpaces[frame] == space) {
+        AddressSpace *heir = FindSharer(frame, space);
+        ownerAddSpaces[frame] = heir;
+        space->numResident--;
+        heir->numResident++;
+    }
+    return true;
+}
+
+int
+CoreMap::FindText(unsigned long long file, unsigned vpn) const {
+    for (int i = textBuckets[TextBucket(file, vpn)]; i != -1;
+         i = textEntries[i].next) {
+        if (textEntries[i].file == file && textEntries[i].vpn == vpn
+              && ownerAddSpaces[i] != nullptr && virtualPageNum[i] == vpn
+              && Maps(i, ownerAddSpaces[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void
+CoreMap::CacheText(unsigned frame, unsigned long long file) {
+    UncacheText(frame);
+
+    unsigned vpn = virtualPageNum[frame];
+    unsigned bucket = TextBucket(file, vpn);
+    textEntries[frame].cached = true;
+    textEntries[frame].file = file;
+    textEntries[frame].vpn = vpn;
+    textEntries[frame].next = textBuckets[bucket];
+    textBuckets[bucket] = frame;
+}
+
+void
+CoreMap::UncacheText(unsigned frame) {
+    TextEntry *entry = &textEntries[frame];
+    if (!entry->cached) {
+        return;
+    }
+    int *link = &textBuckets[TextBucket(entry->file, entry->vpn)];
+    while (*link != (int) frame) {
+        link = &textEntries[*link].next;
+    }
+    *link = entry->next;
+    entry->cached = false;
+}
+
+unsigned
+CoreMap::TextBucket(unsigned long long file, unsigned vpn) const {
+    return (file * 31 + vpn) % NUM_PHYS_PAGES;
+}
+
+unsigned
+CoreMap::GetZeroFrame() const {
+    return zeroFrame;
+}
+
+void
+CoreMap::ZeroFree() {
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    for (;;) {
+        zeroWakeUp->P();
+        pagingLock->Acquire();
+        for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+            if (pageMap->Test(i) || zeroed[i]) {
+                continue;
+            }
+        #ifdef PAGEOUT_DAEMON
+            if (formerOwners[i] != nullptr) {
+                continue;  // Its page may still be reclaimed.
+            }
+        #endif
+            memset(mainMemory + i * PAGE_SIZE, 0, PAGE_SIZE);
+            zeroed[i] = true;
+            stats->numZeroedFrames++;
+        }
+        zeroerAwake = false;
+        pagingLock->Release();
+    }
+}
+
+void
+CoreMap::WakeZeroer() {
+    if (!zeroerAwake) {
+        zeroerAwake = true;
+        zeroWakeUp->V();
+    }
+}
+
+bool
+CoreMap::Maps(unsigned frame, const AddressSpace *space) const {
+    unsigned vpn = virtualPageNum[frame];
+    if (vpn >= space->GetNumPages()) {
+        return false;
+    }
+    const TranslationEntry *entry = space->pageTable->Find(vpn);
+    return entry != nullptr && entry->valid && entry->physicalPage == frame;
+}
+
+AddressSpace *
+CoreMap::FindSharer(unsigned frame, const AddressSpace *space) const {
+    for (unsigned i = 0; i < Table<AddressSpace *>::SIZE; i++) {
+        AddressSpace *other = spaces->Get(i);
+        if (other != nullptr && other != space && Maps(frame, other)) {
+            return other;
+        }
+    }
+    ASSERT(false);
+    return nullptr;
+}
+
 // Ejercicio 4c plancha 4
 int
-CoreMap::PickVictim() {
+CoreMap::PickVictim(const AddressSpace *space) {
+    VictimScope scope = GetScope(space);
 
 // Ejercicio 5b plancha 4
 #ifdef PRPOLICY_LRU
-    unsigned maxIndex = -1;
-    unsigned max = -1;
+    int maxIndex = -1;
+    unsigned max = 0;
 
     for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
-        if (bitsReferencia[i] > max) {
+        if (IsCandidate(i, space, scope)
+              && (maxIndex == -1 || bitsReferencia[i] > max)) {
             max = bitsReferencia[i];
             maxIndex = i;
         }
@@ -94,20 +434,345 @@ CoreMap::PickVictim() {
     return maxIndex;
 
 #elif PRPOLICY_FIFO
+    while (!IsCandidate(victimPointer, space, scope)) {
+        victimPointer = (victimPointer + 1) % NUM_PHYS_PAGES;
+    }
     unsigned victimIndex = victimPointer;
     victimPointer = (victimPointer + 1) % NUM_PHYS_PAGES;
     return victimIndex;
-    
+
+#elif PRPOLICY_CLOCK
+    // Some frame is a candidate, so the hand stops within two turns.
+    for (;;) {
+        unsigned frame = clockHand;
+        clockHand = (clockHand + 1) % NUM_PHYS_PAGES;
+        if (!IsCandidate(frame, space, scope)) {
+            continue;  // Its bit is left alone.
+        }
+
+        AddressSpace *owner = ownerAddSpaces[frame];
+        unsigned vpn = virtualPageNum[frame];
+        TranslationEntry *entry = owner->pageTable->Find(vpn);
+    #ifdef USE_TLB
+        // References made through the TLB only set the bit there.
+        tlbManager->SaveUse(owner, vpn);
+    #endif
+        if (!entry->use) {
+            return frame;
+        }
+        entry->use = false;
+    }
+
 #else // Random
-    srand(time(NULL));
-    unsigned i = 0;
-    for (; i < NUM_PHYS_PAGES && pageMap->Test(i); i++);
+    // The first candidate from a random frame on is taken.
+    unsigned frame = SystemDep::Random() % NUM_PHYS_PAGES;
+    while (!IsCandidate(frame, space, scope)) {
+        frame = (frame + 1) % NUM_PHYS_PAGES;
+    }
+    return frame;
+#endif
+}
 
-    int victimIndex = rand() % (i + 1);
-    return victimIndex;
+#ifdef SWAP
+unsigned
+CoreMap::PageOut(unsigned frame) {
+    AddressSpace *owner = ownerAddSpaces[frame];
+    unsigned vpn = virtualPageNum[frame];
+    unsigned written = 0;
+
+    // Those that share it keep their own copies.
+    for (; refCount[frame] > 1; refCount[frame]--) {
+        AddressSpace *sharer = FindSharer(frame, owner);
+        written += sharer->WriteToSwap(vpn, frame * PAGE_SIZE);
+    }
+    written += owner->WriteToSwap(vpn, frame * PAGE_SIZE);
+    owner->numResident--;
+    return written;
+}
 #endif
+
+CoreMap::VictimScope
+CoreMap::GetScope(const AddressSpace *space) const {
+#ifdef PFF
+    if (space != nullptr
+          && space->numResident >= space->quota && space->numResident > 0) {
+        return OWN_PAGES;
+    }
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        const AddressSpace *owner = ownerAddSpaces[i];
+        if (owner != nullptr && owner->numResident > owner->quota) {
+            return OVER_QUOTA;
+        }
+    }
+#endif
+    return ANY_PAGE;
 }
 
+bool
+CoreMap::IsCandidate(unsigned frame, const AddressSpace *space,
+                     VictimScope scope) const {
+    const AddressSpace *owner = ownerAddSpaces[frame];
+    if (owner == nullptr) {
+        return false;  // Free.
+    }
+    const TranslationEntry *entry
+      = owner->pageTable->Find(virtualPageNum[frame]);
+    if (entry == nullptr || !entry->valid) {
+        return false;  // Still being loaded.
+    }
+#ifdef PFF
+    if (scope == OWN_PAGES) {
+        return owner == space;
+    }
+    if (scope == OVER_QUOTA) {
+        return owner->numResident > owner->quota;
+    }
+#endif
+    return true;
+}
+
+#ifdef PFF
+
+void
+CoreMap::Admit(AddressSpace *space) {
+    space->quota = PFF_MIN_QUOTA;
+    space->lastFault = stats->totalTicks;
+    space->admittedAt = stats->totalTicks;
+    space->suspendedAt = 0;
+    space->swappedOut = false;
+    committed += space->quota;
+}
+
+void
+CoreMap::AdjustQuota(AddressSpace *space) {
+    if (space->swappedOut) {
+        WaitResume(space);  // Suspended to make room for another one.
+    }
+
+    unsigned long interval = stats->totalTicks - space->lastFault;
+    space->lastFault = stats->totalTicks;
+
+    if (interval > PFF_HIGH_INTERVAL && space->quota > PFF_MIN_QUOTA) {
+        // Few faults: the extra frames go back to the others.
+        space->quota--;
+        committed--;
+        stats->numQuotaCuts++;
+        ResumeSuspended();
+    } else if (space->numResident >= space->quota
+                 && space->quota < space->GetNumPages()) {
+        // Frames not in any quota are there for the taking; past that,
+        // only too many faults earn one.
+        if (committed < NUM_PHYS_PAGES
+              || (interval < PFF_LOW_INTERVAL && TakeIdleFrame(space))) {
+            space->quota++;
+            committed++;
+            stats->numQuotaRaises++;
+        } else if (interval < PFF_LOW_INTERVAL) {
+            AddressSpace *victim = PickToSuspend(space);
+            if (victim == space) {
+                Suspend(space);
+                WaitResume(space);
+            } else if (victim != nullptr) {
+                Suspend(victim);
+                space->quota++;
+                committed++;
+                stats->numQuotaRaises++;
+            }
+        }
+    }
+}
+
+bool
+CoreMap::TakeIdleFrame(const AddressSpace *space) {
+    // Only address spaces holding frames are looked for, since the quota
+    // of the others is not in use.
+    AddressSpace *idlest = nullptr;
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        AddressSpace *owner = ownerAddSpaces[i];
+        if (owner != nullptr && owner != space
+              && owner->quota > PFF_MIN_QUOTA
+              && (idlest == nullptr || owner->lastFault < idlest->lastFault)) {
+            idlest = owner;
+        }
+    }
+    if (idlest == nullptr
+          || stats->totalTicks - idlest->lastFault <= PFF_HIGH_INTERVAL) {
+        return false;
+    }
+
+    // Its frame past the quota goes to the next page fault that needs one.
+    idlest->quota--;
+    committed--;
+    stats->numQuotaCuts++;
+    return true;
+}
+
+AddressSpace *
+CoreMap::PickToSuspend(AddressSpace *space) const {
+    // Those without frames have nothing to give, and those that are idle
+    // would not use the frames of `space` anyway.
+    AddressSpace *newest = space;
+    bool othersBusy = false;
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        AddressSpace *owner = ownerAddSpaces[i];
+        if (owner == nullptr || owner == space
+              || stats->totalTicks - owner->lastFault > PFF_HIGH_INTERVAL) {
+            continue;
+        }
+        othersBusy = true;
+        if (owner->admittedAt > newest->admittedAt) {
+            newest = owner;
+        }
+    }
+    return othersBusy ? newest : nullptr;
+}
+
+void
+CoreMap::Suspend(AddressSpace *space) {
+    DEBUG('m', "Suspending address space %p, %u frames\n",
+          space, space->numResident);
+    stats->numSuspensions++;
+
+    // Its pages go out, so that the others get its frames.
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        if (ownerAddSpaces[i] == space) {
+            PageOut(i);
+            pageMap->Clear(i);
+            machine->GetMMU()->InvalidateFrame(i);
+            ownerAddSpaces[i] = nullptr;
+        }
+    }
+    space->numResident = 0;
+    committed -= space->quota;
+    WakeZeroer();
+
+    // It gets back the quota it asked for.
+    if (space->quota < NUM_PHYS_PAGES) {
+        space->quota++;
+    }
+    space->suspendedAt = stats->totalTicks;
+    space->swappedOut = true;
+    suspended->Append(space);
+}
+
+void
+CoreMap::WaitResume(AddressSpace *space) {
+    space->swappedOut = false;
+    pagingLock->Release();
+    space->resume->P();
+    pagingLock->Acquire();
+    DEBUG('m', "Resuming address space %p\n", space);
+}
+
+void
+CoreMap::ResumeSuspended(bool force) {
+    while (!suspended->IsEmpty()) {
+        AddressSpace *space = suspended->Head();
+        bool fits = committed + space->quota <= NUM_PHYS_PAGES;
+        if (!fits && !force
+              && stats->totalTicks - space->suspendedAt < PFF_SUSPEND_TICKS) {
+            return;
+        }
+        suspended->Pop();
+        space->lastFault = stats->totalTicks;
+        space->resume->V();
+        if (fits) {
+            committed += space->quota;
+            continue;
+        }
+
+        // Otherwise it gets what is left, and memory may be overcommitted
+        // for a while: the frames it needs are taken from anyone.  Only
+        // one is let in that way.
+        unsigned left = committed < NUM_PHYS_PAGES
+                        ? NUM_PHYS_PAGES - committed : 0;
+        space->quota = left > PFF_MIN_QUOTA ? left : PFF_MIN_QUOTA;
+        committed += space->quota;
+        return;
+    }
+}
+
+#endif
+
+#ifdef PAGEOUT_DAEMON
+
+void
+CoreMap::Pageout() {
+    for (;;) {
+        pageoutWakeUp->P();
+        pagingLock->Acquire();
+        DEBUG('m', "Pageout daemon: %u free frames\n", pageMap->CountClear());
+
+        while (pageMap->CountClear() < highWatermark && HasSurplus()) {
+            int frame = PickVictim(nullptr);
+            if (frame == -1) {
+                break;
+            }
+            DEBUG('m', "Pageout daemon: freeing frame %d\n", frame);
+            if (PageOut(frame) > 0) {
+                stats->numPageoutWrites++;
+            }
+            stats->numPageoutFrees++;
+
+            pageMap->Clear(frame);
+            machine->GetMMU()->InvalidateFrame(frame);
+            formerOwners[frame] = ownerAddSpaces[frame];
+            ownerAddSpaces[frame] = nullptr;
+        }
+        pageoutAwake = false;
+        pagingLock->Release();
+    }
+}
+
+bool
+CoreMap::HasSurplus() const {
+#ifdef PFF
+    // Frames within quotas belong to their address spaces; only those past
+    // them are taken.
+    return GetScope(nullptr) == OVER_QUOTA;
+#else
+    return true;
+#endif
+}
+
+int
+CoreMap::Reclaim(unsigned vpn, AddressSpace *space) {
+    int frame = -1;
+    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
+        if (formerOwners[i] == space && virtualPageNum[i] == vpn) {
+            frame = i;
+            break;
+        }
+    }
+    if (frame == -1) {
+        return -1;
+    }
+
+    // Either way, the copy in the frame is not to be used again: from now
+    // on, the page may change elsewhere.
+    formerOwners[frame] = nullptr;
+    #ifdef PFF
+    if (space->numResident >= space->quota) {
+        return -1;  // Its own pages are replaced instead.
+    }
+    #endif
+
+    DEBUG('m', "Reclaiming frame %d\n", frame);
+    space->numPageFaults++;
+    pageMap->Mark(frame);
+    ownerAddSpaces[frame] = space;
+    refCount[frame] = 1;
+    UncacheText(frame);  // Cached again if it is code.
+    space->numResident++;
+    stats->numPageReclaims++;
+    #ifdef PRPOLICY_LRU
+    UpdateReferenceBits(frame);
+    #endif
+    return frame;
+}
+
+#endif
+
 // Ejercicio 5b plancha 4
 #ifdef PRPOLICY_LRU
 
@@ -3,9 +3,63 @@
 
 #include "lib/bitmap.hh"
 #include "lib/list.hh"
+#include "lib/table.hh"
 #include "machine/mmu.hh"
 #include "../userprog/address_space.hh"
 
+
+class Lock;
+class Semaphore;
+
+#ifdef PFF
+// Page fault frequency frame allocation.
+//
+// Every address space holds at most its quota of frames; past it, its page
+// faults replace its own pages.  Quotas grow by a frame at a time, while
+// some frames are in none.  After that, at every page fault, the time since
+// the previous one is measured: below `PFF_LOW_INTERVAL` ticks, the quota
+// grows by a frame; above `PFF_HIGH_INTERVAL`, it shrinks by one, but never
+// below `PFF_MIN_QUOTA`.
+//
+// The quotas of the address spaces that run add up to the memory at most.
+// When one should grow but there is no room, a frame is taken from the
+// address space that has not faulted for the longest time, if that is more
+// than `PFF_HIGH_INTERVAL`.  Otherwise, out of the faulting one and those
+// that fault often too, the one created last is suspended: its pages are
+// written out, and at its next page fault it waits until there is room for
+// the quota it asked for, or for `PFF_SUSPEND_TICKS` at most, lest the ones
+// that run wait for it.  Nor does it wait while the machine is idle.
+const unsigned      PFF_MIN_QUOTA     = 4;
+const unsigned long PFF_LOW_INTERVAL  = 1000;
+const unsigned long PFF_HIGH_INTERVAL = 20000;
+const unsigned long PFF_SUSPEND_TICKS = 1000000;
+#endif
+
+#ifdef PAGEOUT_DAEMON
+// Pageout daemon.
+//
+// A kernel thread keeps some frames free, so that page faults seldom have to
+// write a page out before loading theirs.  It is woken up when a page fault
+// leaves fewer free frames than the low watermark, and then takes pages out,
+// chosen as page faults would, until the high watermark is reached.  Both are
+// percentages of the frames, and at least one frame.
+//
+// A frame freed by the daemon keeps its page until it is booked again, so a
+// page that was taken out too early can be reclaimed without reading it.
+const unsigned PAGEOUT_LOW_PERCENT  = 5;
+const unsigned PAGEOUT_HIGH_PERCENT = 10;
+#endif
+
+// Zero page.
+//
+// Pages of uninitialized data and stack that were never written to hold
+// nothing but zeros, so they are all mapped read-only to a single frame,
+// filled with zeros when the kernel boots and never taken out.  At the
+// first write to one of them, the page gets a frame of its own (see
+// `AddressSpace::CopyOnWrite`).  Those frames are taken from the free ones
+// that a kernel thread fills with zeros whenever frames are freed; only if
+// there is none is one zeroed then.
+
 class CoreMap{
     public:
         CoreMap();
@@ -15,12 +69,91 @@ class CoreMap{
         // Reserva una página física y retorna su índice
         // Si todas las páginas están asignadas,
         // La envia al area de intercambio
-        int BookPage(unsigned int vpn, AddressSpace *space);
+        //
+        // If `zero` is set, the frame is filled with zeros, preferably one
+        // that was zeroed already.
+        int BookPage(unsigned int vpn, AddressSpace *space, bool zero = false);
 
         void ReleasePages(AddressSpace *addressSpace);
 
         unsigned CountClear();
 
+#ifdef SWAP
+        // Book a free frame for virtual page `vpn` of `space`, read from
+        // swap along with the page that faulted, and return its index; or
+        // -1 if no frame can be spared, or the page is still in a frame
+        // freed by the pageout daemon.
+        int BookSpare(unsigned vpn, AddressSpace *space);
+#endif
+
+        // Held while pages are moved in or out of memory, from booking the
+        // frame to mapping the page, so that no one else finds them halfway
+        // while the disk is being waited for.
+        Lock *pagingLock;
+
+        // Copy-on-write.
+        //
+        // After `Fork`, or when it holds code, a frame may be mapped
+        // read-only by several address spaces, at the same virtual page.  It
+        // is accounted to one of them, its owner; when that one stops mapping
+        // it, it goes to another.  When it is taken out of memory, each of
+        // them writes the page out to its own slot, if it has to.
+
+        // Keep track of `space`, that may come to share frames.
+        void AddSpace(AddressSpace *space);
+
+        // Let `space` map `frame` too.
+        void Share(unsigned frame, AddressSpace *space);
+
+        // Stop `space` mapping `frame` and return true, unless no other
+        // address space maps it, in which case it is left alone.
+        bool Unshare(unsigned frame, AddressSpace *space);
+
+        // Shared text.
+        //
+        // A page that holds nothing but code is read from the executable
+        // once, by the first address space running it that needs it; the
+        // others running the same one find it in its frame, by the file of
+        // the executable (see `OpenFile::GetId`) and the page, and share it.
+        // It is never written out, as it can be read again.
+
+        // Return the frame holding virtual page `vpn` of the code of the
+        // executable `file`, as read from it, or -1 if there is none.
+        int FindText(unsigned long long file, unsigned vpn) const;
+
+        // Record that `frame` holds its page as read from the executable
+        // `file`.
+        void CacheText(unsigned frame, unsigned long long file);
+
+        // Record that `frame` may not hold code as read any more.
+        void UncacheText(unsigned frame);
+
+        // Return the frame that the pages of zeros are mapped to.
+        unsigned GetZeroFrame() const;
+
+        // Body of the zeroing thread: fill free frames with zeros whenever
+        // woken up.
+        void ZeroFree();
+
+#ifdef PFF
+        // Give a new address space its first quota.
+        void Admit(AddressSpace *space);
+
+        // Resume the suspended address spaces that fit in memory again, or
+        // have waited too long; or all of them, if `force` is set.
+        void ResumeSuspended(bool force = false);
+#endif
+
+#ifdef PAGEOUT_DAEMON
+        // Body of the pageout daemon: free frames whenever woken up.
+        void Pageout();
+
+        // Book again the frame freed by the daemon that still holds virtual
+        // page `vpn` of `space`, and return its index; or -1 if there is
+        // none, in which case the page has to be read.
+        int Reclaim(unsigned vpn, AddressSpace *space);
+#endif
+
 // Ejercicio 5b plancha 4
 #ifdef PRPOLICY_LRU
     private:
@@ -37,10 +170,124 @@ class CoreMap{
     private:
         unsigned victimPointer;
 
+#endif
+
+#ifdef PRPOLICY_CLOCK
+    private:
+        // Next frame the clock hand looks at.  Frames whose page has its
+        // `use` bit set get a second chance: the bit is cleared and the
+        // hand moves on.
+        unsigned clockHand;
 #endif
         
     private:
-        int PickVictim();
+        // Which frames may be taken for a page of an address space: its
+        // own, if it holds its whole quota; else those of address spaces
+        // past their quota, if any; else any.
+        enum VictimScope { OWN_PAGES, OVER_QUOTA, ANY_PAGE };
+
+        VictimScope GetScope(const AddressSpace *space) const;
+
+        bool IsCandidate(unsigned frame, const AddressSpace *space,
+                         VictimScope scope) const;
+
+        // Choose the frame to take for a page of `space`, or to free, if
+        // `space` is null.
+        int PickVictim(const AddressSpace *space);
+
+#ifdef SWAP
+        // Write the page in `frame` out, if it was modified, and take it
+        // from its address space.  Return the number of bytes written.
+        unsigned PageOut(unsigned frame);
+#endif
+
+#ifdef PAGEOUT_DAEMON
+        // Whether the daemon may take frames from address spaces.
+        bool HasSurplus() const;
+#endif
+
+#ifdef PFF
+        // Update the quota of `space`, that has just faulted.
+        void AdjustQuota(AddressSpace *space);
+
+        // Lower the quota of the address space, other than `space`, that has
+        // been idle the longest.  Return false if none has been idle enough.
+        bool TakeIdleFrame(const AddressSpace *space);
+
+        // Choose the address space to suspend, so that `space` gets more
+        // frames: the one admitted last, out of `space` and those busy
+        // holding frames; or none, if no other is busy.
+        AddressSpace *PickToSuspend(AddressSpace *space) const;
+
+        // Write out every page of `space`, and put it aside until it is
+        // resumed.
+        void Suspend(AddressSpace *space);
+
+        // Wait until `space`, the running one, suspended, is resumed.
+        void WaitResume(AddressSpace *space);
+
+        // Address spaces suspended, in order.
+        List<AddressSpace *> *suspended;
+
+        // Sum of the quotas of the address spaces that are not suspended.
+        unsigned committed;
+#endif
+
+#ifdef PAGEOUT_DAEMON
+        // Free frames to keep, at least and at most.
+        unsigned lowWatermark;
+        unsigned highWatermark;
+
+        // The daemon waits on it, and is woken up at most once.
+        Semaphore *pageoutWakeUp;
+        bool pageoutAwake;
+
+        // Address space whose page is still in each free frame, if any;
+        // which page is in `virtualPageNum`.
+        AddressSpace **formerOwners;
+#endif
+
+        // Whether `space` maps `frame`.
+        bool Maps(unsigned frame, const AddressSpace *space) const;
+
+        // Return the address space, other than `space`, that maps `frame`.
+        AddressSpace *FindSharer(unsigned frame,
+                                 const AddressSpace *space) const;
+
+        // Number of address spaces that map each frame.
+        unsigned *refCount;
+
+        // Code that each frame holds, as read from an executable.  Frames
+        // are chained in buckets, by executable and page.
+        struct TextEntry {
+            bool cached;
+            unsigned long long file;
+            unsigned vpn;
+            int next;  // Next frame in the bucket, or -1.
+        };
+        TextEntry *textEntries;
+
+        // First frame of each bucket, or -1.
+        int *textBuckets;
+
+        // Return the bucket of virtual page `vpn` of the executable `file`.
+        unsigned TextBucket(unsigned long long file, unsigned vpn) const;
+
+        // Wake the zeroing thread up, unless it is awake already.
+        void WakeZeroer();
+
+        // Frame of zeros, mapped by every page of zeros.
+        unsigned zeroFrame;
+
+        // Whether each free frame is known to hold only zeros.
+        bool *zeroed;
+
+        // The zeroing thread waits on it, and is woken up at most once.
+        Semaphore *zeroWakeUp;
+        bool zeroerAwake;
+
+        // Address spaces, as given to `AddSpace`.
+        Table<AddressSpace *> *spaces;
 
         // Available physical pages
         Bitmap *pageMap;
@@ -0,0 +1,420 @@
+/// Routines to manage the swap area.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "swap_area.hh"
+#include "threads/system.hh"
+#ifdef FILESYS
+#include "filesys/directory_entry.hh"
+#include "filesys/raw_file_header.hh"
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+#if defined(SWAP_ON_DISK) && !defined(FILESYS)
+#error "SWAP_ON_DISK needs the file system (FILESYS)."
+#endif
+
+#ifdef SWAP_POOL
+
+/// Compress `page` into `out`, that has room for a page, and return the
+/// size of the result; or `PAGE_SIZE` if it is not smaller than that.
+///
+/// Pages hold words, many of them zero or close to the one before them
+/// (counters, indices, addresses).  So every word is kept as its difference
+/// with the one before, in as few bytes as it fits in: none, one, two or
+/// four, told by a tag of two bits per word.  The tags go first.
+static unsigned
+Compress(const char *page, char *out)
+{
+    unsigned numWords = PAGE_SIZE / 4;
+    unsigned size = DivRoundUp(numWords, 4u);
+    memset(out, 0, size);
+
+    uint32_t previous = 0;
+    for (unsigned i = 0; i < numWords; i++) {
+        uint32_t word;
+        memcpy(&word, page + i * 4, 4);
+        int32_t delta = (int32_t) (word - previous);
+        previous = word;
+
+        unsigned tag = delta == 0                     ? 0
+                     : delta == (int8_t) delta        ? 1
+                     : delta == (int16_t) delta       ? 2 : 3;
+        unsigned length = tag == 3 ? 4 : tag;
+        if (size + length >= PAGE_SIZE) {
+            return PAGE_SIZE;
+        }
+        out[i / 4] |= tag << (i % 4 * 2);
+        for (unsigned j = 0; j < length; j++) {
+            out[size++] = (char) ((uint32_t) delta >> (j * 8));
+        }
+    }
+    return size;
+}
+
+/// Expand the `size` bytes at `data`, made by `Compress`, into `page`.
+static void
+Decompress(const char *data, unsigned size, char *page)
+{
+    unsigned numWords = PAGE_SIZE / 4;
+    unsigned in = DivRoundUp(numWords, 4u);
+
+    uint32_t previous = 0;
+    for (unsigned i = 0; i < numWords; i++) {
+        unsigned tag = (unsigned char) data[i / 4] >> (i % 4 * 2) & 3;
+        unsigned length = tag == 3 ? 4 : tag;
+        uint32_t delta = 0;
+        for (unsigned j = 0; j < length; j++) {
+            delta |= (uint32_t) (unsigned char) data[in++] << (j * 8);
+        }
+        if (tag == 1) {
+            delta = (uint32_t) (int8_t) delta;
+        } else if (tag == 2) {
+            delta = (uint32_t) (int16_t) delta;
+        }
+        previous += delta;
+        memcpy(page + i * 4, &previous, 4);
+    }
+    ASSERT(in == size);
+}
+
+#endif
+
+SwapArea::SwapArea()
+{
+#ifdef SWAP_ON_DISK
+    sectorsPerSlot = DivRoundUp(PAGE_SIZE, SECTOR_SIZE);
+    numSlots = NUM_SWAP_SECTORS / sectorsPerSlot;
+#else
+#ifdef FILESYS_STUB
+    slotsPerFile = NUM_SWAP_SLOTS;
+#else
+    slotsPerFile = (MAX_FILE_SIZE - 1) / PAGE_SIZE;  // It must be smaller.
+#endif
+    slotsPerFile -= slotsPerFile % SWAP_CLUSTER;  // No cluster spans two.
+    numSlots = NUM_SWAP_FILES * slotsPerFile;
+    fileNames = new char *[NUM_SWAP_FILES];
+    files = new OpenFile *[NUM_SWAP_FILES];
+    for (unsigned i = 0; i < NUM_SWAP_FILES; i++) {
+#ifdef FILESYS_STUB
+        // A host file, named after the kernel instance.
+        fileNames[i] = new char [strlen(hostFilePrefix) + 5];
+        sprintf(fileNames[i], "%sSWAP", hostFilePrefix);
+#else
+        fileNames[i] = new char [FILE_NAME_MAX_LEN + 1];
+        snprintf(fileNames[i], FILE_NAME_MAX_LEN + 1, "SWAP.%u", i);
+#endif
+        files[i] = nullptr;
+    }
+#endif
+    numSlots -= numSlots % SWAP_CLUSTER;
+    ASSERT(numSlots > 0);
+    clusterMap = new Bitmap(numSlots / SWAP_CLUSTER);
+    DEBUG('a', "Swap area of %u slots\n", numSlots);
+
+#ifdef SWAP_POOL
+    poolPages = new char *[numSlots];
+    poolSizes = new unsigned [numSlots];
+    for (unsigned i = 0; i < numSlots; i++) {
+        poolPages[i] = nullptr;
+        poolSizes[i] = 0;
+    }
+    poolOrder = new List<unsigned>;
+    compressed = new char [PAGE_SIZE];
+    poolUsed = 0;
+    poolCapacity = MEMORY_SIZE * SWAP_POOL_PERCENT / 100;
+    DEBUG('a', "Swap pool of %u bytes\n", poolCapacity);
+#endif
+}
+
+SwapArea::~SwapArea()
+{
+#ifndef SWAP_ON_DISK
+    for (unsigned i = 0; i < NUM_SWAP_FILES; i++) {
+#ifdef FILESYS_STUB
+        if (files[i] != nullptr) {
+            fileSystem->Remove(fileNames[i]);
+        }
+#endif
+        delete files[i];
+        delete [] fileNames[i];
+    }
+    delete [] files;
+    delete [] fileNames;
+#endif
+    delete clusterMap;
+#ifdef SWAP_POOL
+    for (unsigned i = 0; i < numSlots; i++) {
+        delete [] poolPages[i];
+    }
+    delete [] poolPages;
+    delete [] poolSizes;
+    delete poolOrder;
+    delete [] compressed;
+#endif
+}
+
+unsigned
+SwapArea::Allocate()
+{
+    int cluster = clusterMap->Find();
+    if (cluster == -1) {
+        return NO_SWAP_SLOT;
+    }
+#ifndef SWAP_ON_DISK
+    if (!OpenFileOf(cluster * SWAP_CLUSTER)) {
+        clusterMap->Clear(cluster);
+        return NO_SWAP_SLOT;
+    }
+#endif
+    return cluster * SWAP_CLUSTER;
+}
+
+void
+SwapArea::Free(unsigned slot)
+{
+    ASSERT(slot < numSlots && slot % SWAP_CLUSTER == 0);
+    ASSERT(clusterMap->Test(slot / SWAP_CLUSTER));
+
+    clusterMap->Clear(slot / SWAP_CLUSTER);
+#ifdef SWAP_POOL
+    for (unsigned i = slot; i < slot + SWAP_CLUSTER; i++) {
+        Drop(i);
+    }
+#endif
+}
+
+void
+SwapArea::Write(unsigned slot, unsigned count, const char *data)
+{
+    ASSERT(count > 0 && slot / SWAP_CLUSTER
+                        == (slot + count - 1) / SWAP_CLUSTER);
+    ASSERT(slot + count <= numSlots);
+    ASSERT(data != nullptr);
+
+#ifdef SWAP_POOL
+    // Those that do not compress go to their slots, in runs.
+    unsigned first = 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (Store(slot + i, data + i * PAGE_SIZE)) {
+            if (first < i) {
+                WriteSlots(slot + first, i - first, data + first * PAGE_SIZE);
+            }
+            first = i + 1;
+        }
+    }
+    if (first < count) {
+        WriteSlots(slot + first, count - first, data + first * PAGE_SIZE);
+    }
+#else
+    WriteSlots(slot, count, data);
+#endif
+}
+
+void
+SwapArea::Read(unsigned slot, unsigned count, char *data)
+{
+    ASSERT(count > 0 && slot / SWAP_CLUSTER
+                        == (slot + count - 1) / SWAP_CLUSTER);
+    ASSERT(slot + count <= numSlots);
+    ASSERT(data != nullptr);
+
+#ifdef SWAP_POOL
+    // Pages missing from the pool are read in a single request, and those
+    // in it among them, newer, are laid over them.
+    unsigned missing = 0, low = slot + count, high = slot;
+    for (unsigned i = slot; i < slot + count; i++) {
+        if (poolPages[i] == nullptr) {
+            missing++;
+            low = i < low ? i : low;
+            high = i + 1;
+        }
+    }
+    if (missing > 0) {
+        ReadSlots(low, high - low, data + (low - slot) * PAGE_SIZE);
+    }
+    for (unsigned i = slot; i < slot + count; i++) {
+        if (poolPages[i] != nullptr) {
+            Decompress(poolPages[i], poolSizes[i],
+                       data + (i - slot) * PAGE_SIZE);
+            poolOrder->Remove(i);
+            poolOrder->Append(i);
+        }
+    }
+    stats->numPoolHits += count - missing;
+    stats->numPoolMisses += missing;
+#else
+    ReadSlots(slot, count, data);
+#endif
+}
+
+unsigned
+SwapArea::GetNumSlots() const
+{
+    return numSlots;
+}
+
+unsigned
+SwapArea::GetNumUsed() const
+{
+    return numSlots - clusterMap->CountClear() * SWAP_CLUSTER;
+}
+
+void
+SwapArea::WriteSlots(unsigned slot, unsigned count, const char *data)
+{
+    stats->numSwapWrites++;
+#ifdef SWAP_ON_DISK
+    // The sectors are consecutive; pages smaller than a sector leave the
+    // rest of it unused.
+    char sector[SECTOR_SIZE];
+    for (unsigned i = 0; i < count * sectorsPerSlot; i++) {
+        unsigned page = i / sectorsPerSlot;
+        unsigned offset = i % sectorsPerSlot * SECTOR_SIZE;
+        unsigned size = PAGE_SIZE - offset < SECTOR_SIZE
+                        ? PAGE_SIZE - offset : SECTOR_SIZE;
+        memcpy(sector, data + page * PAGE_SIZE + offset, size);
+        memset(sector + size, 0, SECTOR_SIZE - size);
+        synchDisk->WriteSector(FIRST_SWAP_SECTOR + slot * sectorsPerSlot + i,
+                               sector);
+    }
+#else
+    OpenFile *file = files[slot / slotsPerFile];
+    ASSERT(file != nullptr);
+    unsigned size = count * PAGE_SIZE;
+    ASSERT(file->WriteAt(data, size, slot % slotsPerFile * PAGE_SIZE)
+             == (int) size);
+#endif
+}
+
+void
+SwapArea::ReadSlots(unsigned slot, unsigned count, char *data)
+{
+    stats->numSwapReads++;
+#ifdef SWAP_ON_DISK
+    char sector[SECTOR_SIZE];
+    for (unsigned i = 0; i < count * sectorsPerSlot; i++) {
+        unsigned page = i / sectorsPerSlot;
+        unsigned offset = i % sectorsPerSlot * SECTOR_SIZE;
+        unsigned size = PAGE_SIZE - offset < SECTOR_SIZE
+                        ? PAGE_SIZE - offset : SECTOR_SIZE;
+        synchDisk->ReadSector(FIRST_SWAP_SECTOR + slot * sectorsPerSlot + i,
+                              sector);
+        memcpy(data + page * PAGE_SIZE + offset, sector, size);
+    }
+#else
+    // Slots past the last one ever written read as zeros.
+    OpenFile *file = files[slot / slotsPerFile];
+    ASSERT(file != nullptr);
+    unsigned size = count * PAGE_SIZE;
+    int read = file->ReadAt(data, size, slot % slotsPerFile * PAGE_SIZE);
+    ASSERT(read >= 0);
+    memset(data + read, 0, size - read);
+#endif
+}
+
+#ifndef SWAP_ON_DISK
+
+bool
+SwapArea::OpenFileOf(unsigned slot)
+{
+    unsigned i = slot / slotsPerFile;
+    if (files[i] != nullptr) {
+        return true;
+    }
+
+    unsigned size = slotsPerFile * PAGE_SIZE;
+    OpenFile *file = nullptr;
+#ifdef FILESYS
+    // One left by an earlier boot is used again, if it is large enough.
+    file = fileSystem->Open(fileNames[i]);
+    if (file != nullptr && file->Length() < size) {
+        delete file;
+        file = nullptr;
+        fileSystem->Remove(fileNames[i]);
+    }
+#endif
+    if (file == nullptr && fileSystem->Create(fileNames[i], size)) {
+        file = fileSystem->Open(fileNames[i]);
+    }
+    DEBUG('a', "Swap file %s %s\n", fileNames[i],
+          file != nullptr ? "open" : "does not fit");
+    files[i] = file;
+    return file != nullptr;
+}
+
+#endif
+
+#ifdef SWAP_POOL
+
+bool
+SwapArea::Store(unsigned slot, const char *page)
+{
+    Drop(slot);  // The copy in the pool, if any, is out of date now.
+
+    unsigned size = Compress(page, compressed);
+    if (size >= PAGE_SIZE || size > poolCapacity) {
+        stats->numPoolRejects++;
+        return false;
+    }
+    while (poolUsed + size > poolCapacity) {
+        Spill();
+    }
+
+    poolPages[slot] = new char [size];
+    memcpy(poolPages[slot], compressed, size);
+    poolSizes[slot] = size;
+    poolUsed += size;
+    poolOrder->Append(slot);
+    stats->numPoolStores++;
+    stats->numPoolPageBytes += PAGE_SIZE;
+    stats->numPoolBytes += size;
+    return true;
+}
+
+void
+SwapArea::Drop(unsigned slot)
+{
+    if (poolPages[slot] == nullptr) {
+        return;
+    }
+    poolOrder->Remove(slot);
+    poolUsed -= poolSizes[slot];
+    delete [] poolPages[slot];
+    poolPages[slot] = nullptr;
+}
+
+void
+SwapArea::Spill()
+{
+    ASSERT(!poolOrder->IsEmpty());
+
+    unsigned slot = poolOrder->Head();
+    unsigned first = slot - slot % SWAP_CLUSTER;
+    unsigned low = slot, high = slot + 1;
+    while (high < first + SWAP_CLUSTER && poolPages[high] != nullptr) {
+        high++;
+    }
+    while (low > first && poolPages[low - 1] != nullptr) {
+        low--;
+    }
+
+    char *buffer = new char [(high - low) * PAGE_SIZE];
+    for (unsigned i = low; i < high; i++) {
+        Decompress(poolPages[i], poolSizes[i], buffer + (i - low) * PAGE_SIZE);
+        Drop(i);
+    }
+    DEBUG('a', "Spilling slots %u to %u out of the swap pool\n", low, high);
+    WriteSlots(low, high - low, buffer);
+    delete [] buffer;
+    stats->numPoolSpills += high - low;
+}
+
+#endif
@@ -0,0 +1,169 @@
+/// Data structures to manage the swap area.
+///
+/// Pages taken out of memory are kept in a single swap area, shared by all
+/// address spaces and split into slots of a page each.  A page gets a slot
+/// the first time it is written out, and keeps it until its address space
+/// is destroyed, so it is written back to the same place every time; the
+/// slot is recorded in its page table entry (`swapSlot`).
+///
+/// Slots are handed out in clusters of `SWAP_CLUSTER`, one for every block
+/// of as many consecutive virtual pages, aligned, that has some page written
+/// out; the pages of a block lie in its cluster in order.  So neighbouring
+/// pages can be read or written together, in a single request: when a page
+/// is written out, so are the modified pages next to it that are in memory,
+/// which stay there clean; and when a page is read back, so are those next
+/// to it that are out, as long as there are free frames for them.  Blocks
+/// with no page ever written out take no room at all.
+///
+/// Under *FILESYS_STUB*, the area is a host file called `SWAP`, named after
+/// the kernel instance, created when the kernel boots and removed when it
+/// halts.  Under *FILESYS*, no file may hold more than `MAX_FILE_SIZE`
+/// bytes, so the area takes up to `NUM_SWAP_FILES` Nachos files, `SWAP.0`
+/// and on, each created the first time one of its slots is used.  They are
+/// kept when the kernel halts, as the disk can no longer be waited for by
+/// then, and used again by the next boot.
+///
+/// If `SWAP_ON_DISK` is defined at build time, under *FILESYS*, the area is
+/// instead the last `NUM_SWAP_SECTORS` sectors of the simulated disk, read
+/// and written directly; the file system does not use them for files.
+///
+/// If `SWAP_POOL` is defined, pages written to a slot are compressed and
+/// kept in a pool in kernel memory instead, of `SWAP_POOL_PERCENT` of the
+/// size of the main memory, and read from there.  When it is full, the
+/// pages used least recently are spilled to their slots, along with those
+/// in the pool next to them, in a single request.  Pages that do not
+/// compress go straight to their slots, together when they are next to each
+/// other.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_SWAPAREA__HH
+#define NACHOS_VMEM_SWAPAREA__HH
+
+
+#include "lib/bitmap.hh"
+#include "lib/list.hh"
+#ifdef SWAP_ON_DISK
+#include "machine/disk.hh"
+#endif
+
+
+class OpenFile;
+
+
+/// Number of slots in a cluster.
+const unsigned SWAP_CLUSTER = 4;
+
+#ifdef SWAP_ON_DISK
+/// Number of sectors at the end of the disk that make up the swap area.
+const unsigned NUM_SWAP_SECTORS = 256;
+const unsigned FIRST_SWAP_SECTOR = NUM_SECTORS - NUM_SWAP_SECTORS;
+#elif defined(FILESYS_STUB)
+/// Number of slots in the swap file on the host.
+const unsigned NUM_SWAP_SLOTS = 4096;
+const unsigned NUM_SWAP_FILES = 1;
+#else
+/// Most Nachos files the area may take.  Each holds as many slots as fit in
+/// the largest file.
+const unsigned NUM_SWAP_FILES = 8;
+#endif
+
+#ifdef SWAP_POOL
+/// Room for compressed pages, as a percentage of the main memory.
+const unsigned SWAP_POOL_PERCENT = 25;
+#endif
+
+class SwapArea {
+public:
+
+    /// Create the swap area, with every slot free.
+    SwapArea();
+
+    ~SwapArea();
+
+    /// Take a free cluster and return its first slot, or `NO_SWAP_SLOT` if
+    /// there is none.
+    unsigned Allocate();
+
+    /// Give back the cluster that starts at `slot`.
+    void Free(unsigned slot);
+
+    /// Copy `count` pages from `data` into the slots starting at `slot`, of
+    /// the same cluster, in one request.
+    void Write(unsigned slot, unsigned count, const char *data);
+
+    /// Copy `count` pages from the slots starting at `slot`, of the same
+    /// cluster, into `data`, in one request.
+    void Read(unsigned slot, unsigned count, char *data);
+
+    /// Return the number of slots.
+    unsigned GetNumSlots() const;
+
+    /// Return the number of slots in use.
+    unsigned GetNumUsed() const;
+
+private:
+
+    /// Copy `count` pages from `data` into the slots starting at `slot`,
+    /// in the area itself.
+    void WriteSlots(unsigned slot, unsigned count, const char *data);
+
+    /// Copy `count` pages from the slots starting at `slot`, in the area
+    /// itself, into `data`.
+    void ReadSlots(unsigned slot, unsigned count, char *data);
+
+#ifdef SWAP_POOL
+    /// Keep `page`, written to `slot`, in the pool, making room for it.
+    /// Return false if it does not compress, and has to go to the slot.
+    bool Store(unsigned slot, const char *page);
+
+    /// Forget the copy of `slot` in the pool, if any.
+    void Drop(unsigned slot);
+
+    /// Write the page used least recently out of the pool, together with
+    /// those of its cluster in the pool next to it.
+    void Spill();
+
+    /// Compressed page of each slot that is in the pool, or null, and its
+    /// size.
+    char **poolPages;
+    unsigned *poolSizes;
+
+    /// Slots in the pool, the least recently used first.
+    List<unsigned> *poolOrder;
+
+    /// Room for a page being compressed.  Kernel stacks are too small for
+    /// one.
+    char *compressed;
+
+    /// Bytes taken by compressed pages, and most they may take.
+    unsigned poolUsed;
+    unsigned poolCapacity;
+#endif
+
+    /// Clusters in use.
+    Bitmap *clusterMap;
+
+    unsigned numSlots;
+
+#ifdef SWAP_ON_DISK
+    /// Number of sectors taken by every slot.
+    unsigned sectorsPerSlot;
+#else
+    /// Open the file that holds `slot`, creating it if it does not exist
+    /// yet.  Return false if there is no room for it.
+    bool OpenFileOf(unsigned slot);
+
+    /// Name of every file, and the file itself once open, or null.
+    char **fileNames;
+    OpenFile **files;
+
+    /// Number of slots in every file.
+    unsigned slotsPerFile;
+#endif
+};
+
+
+#endif
@@ -0,0 +1,347 @@
+/// Routines to manage the contents of the TLB.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "tlb_manager.hh"
+#include "machine/system_dep.hh"
+#include "threads/system.hh"
+#include "userprog/address_space.hh"
+
+#include <string.h>
+
+
+static const char *const POLICY_NAMES[NUM_TLB_POLICIES] = {
+    "fifo", "random", "clock", "lru"
+};
+
+TLBManager::TLBManager(TLBPolicy policy_, bool warmUp_, bool prefetch_)
+{
+    ASSERT(policy_ < NUM_TLB_POLICIES);
+
+    policy = policy_;
+    hand = 0;
+    for (unsigned i = 0; i < NUM_ASIDS; i++) {
+        owners[i] = nullptr;
+        hotPages[i] = new unsigned [TLB_SIZE];
+        numHotPages[i] = 0;
+    }
+    asidHand = 0;
+    warmUp   = warmUp_ || prefetch_;
+    prefetch = prefetch_;
+    strncpy(stats->tlbPolicy, POLICY_NAMES[policy], sizeof stats->tlbPolicy);
+    stats->tlbPolicy[sizeof stats->tlbPolicy - 1] = '\0';
+}
+
+TLBManager::~TLBManager()
+{
+    for (unsigned i = 0; i < NUM_ASIDS; i++) {
+        delete [] hotPages[i];
+    }
+}
+
+unsigned
+TLBManager::Load(const TranslationEntry &entry)
+{
+    MMU *mmu = machine->GetMMU();
+
+    unsigned i = PickVictim();
+    if (mmu->tlb[i].valid) {
+        DEBUG('T', "Replacing TLB entry %u, ASID %u, virtual page %u\n",
+              i, mmu->tlb[i].asid, mmu->tlb[i].virtualPage);
+        SaveEntry(mmu->tlb[i]);
+    }
+    mmu->tlb[i] = entry;
+    mmu->tlb[i].asid = mmu->currentAsid;
+    mmu->tlbLastUse[i] = stats->numTlbHits;
+    AddressSpace *space = owners[mmu->currentAsid];
+    mmu->tlbOrigin[i] = space->pageTable->Get(entry.virtualPage);
+    mmu->tlbPreloaded[i] = false;
+    mmu->FlushHostCache();
+    return i;
+}
+
+void
+TLBManager::Invalidate(AddressSpace *space, unsigned vpn)
+{
+    ASSERT(space != nullptr);
+
+    unsigned asid = FindAsid(space);
+    if (asid == NUM_ASIDS) {
+        return;
+    }
+
+    MMU *mmu = machine->GetMMU();
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        TranslationEntry *e = &mmu->tlb[i];
+        if (e->valid && e->asid == asid && e->virtualPage == vpn) {
+            SaveEntry(*e);
+            e->valid = false;
+            mmu->FlushHostCache();
+        }
+    }
+}
+
+void
+TLBManager::SaveUse(AddressSpace *space, unsigned vpn)
+{
+    ASSERT(space != nullptr);
+
+    unsigned asid = FindAsid(space);
+    if (asid == NUM_ASIDS) {
+        return;
+    }
+
+    MMU *mmu = machine->GetMMU();
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        TranslationEntry *e = &mmu->tlb[i];
+        if (e->valid && e->asid == asid && e->virtualPage == vpn) {
+            SaveEntry(*e);
+            e->use = false;
+        }
+    }
+}
+
+void
+TLBManager::Clean(AddressSpace *space, unsigned vpn)
+{
+    ASSERT(space != nullptr);
+
+    unsigned asid = FindAsid(space);
+    if (asid == NUM_ASIDS) {
+        return;
+    }
+
+    MMU *mmu = machine->GetMMU();
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        TranslationEntry *e = &mmu->tlb[i];
+        if (e->valid && e->asid == asid && e->virtualPage == vpn) {
+            SaveEntry(*e);
+            e->dirty = false;
+        }
+    }
+}
+
+void
+TLBManager::SwitchTo(AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    unsigned asid = FindAsid(space);
+    if (asid == NUM_ASIDS) {
+        asid = FindAsid(nullptr);
+        if (asid == NUM_ASIDS) {
+            asid = asidHand;
+            asidHand = (asidHand + 1) % NUM_ASIDS;
+            DEBUG('T', "Recycling ASID %u\n", asid);
+            InvalidateAsid(asid);
+        }
+        owners[asid] = space;
+        numHotPages[asid] = 0;
+    }
+
+    MMU *mmu = machine->GetMMU();
+    mmu->currentAsid = asid;
+    mmu->FlushHostCache();
+}
+
+void
+TLBManager::Release(AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    unsigned asid = FindAsid(space);
+    if (asid != NUM_ASIDS) {
+        InvalidateAsid(asid);
+        owners[asid] = nullptr;
+    }
+}
+
+void
+TLBManager::Record(AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    unsigned asid = FindAsid(space);
+    if (!warmUp || asid == NUM_ASIDS) {
+        return;
+    }
+
+    // Insert the entries of `space` sorted by their last use, the most
+    // recent first, then replace them by their pages.
+    MMU *mmu = machine->GetMMU();
+    unsigned *slots = hotPages[asid];
+    unsigned n = 0;
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        const TranslationEntry *e = &mmu->tlb[i];
+        if (!e->valid || e->asid != asid) {
+            continue;
+        }
+        unsigned j = n++;
+        for (; j > 0 && mmu->tlbLastUse[slots[j - 1]] < mmu->tlbLastUse[i];
+             j--) {
+            slots[j] = slots[j - 1];
+        }
+        slots[j] = i;
+    }
+    for (unsigned j = 0; j < n; j++) {
+        slots[j] = mmu->tlb[slots[j]].virtualPage;
+    }
+    numHotPages[asid] = n;
+}
+
+void
+TLBManager::WarmUp(AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    unsigned asid = FindAsid(space);
+    ASSERT(asid == machine->GetMMU()->currentAsid);
+    if (!warmUp) {
+        return;
+    }
+
+    // The least recently used go first, so that they are the first to be
+    // replaced, should the TLB be too small for all of them.
+    for (unsigned i = numHotPages[asid]; i > 0; i--) {
+        Preload(space, hotPages[asid][i - 1]);
+    }
+    if (prefetch) {
+        Preload(space, machine->ReadRegister(STACK_REG) / PAGE_SIZE);
+        Preload(space, machine->ReadRegister(PC_REG) / PAGE_SIZE);
+    }
+}
+
+TLBPolicy
+TLBManager::GetPolicy() const
+{
+    return policy;
+}
+
+bool
+TLBManager::ParsePolicy(const char *name, TLBPolicy *policy)
+{
+    ASSERT(name != nullptr);
+    ASSERT(policy != nullptr);
+
+    for (unsigned i = 0; i < NUM_TLB_POLICIES; i++) {
+        if (strcmp(name, POLICY_NAMES[i]) == 0) {
+            *policy = (TLBPolicy) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned
+TLBManager::PickVictim()
+{
+    MMU *mmu = machine->GetMMU();
+
+    // Free entries are used first, whatever the policy.
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        if (!mmu->tlb[i].valid) {
+            return i;
+        }
+    }
+
+    unsigned victim = 0;
+    switch (policy) {
+        case TLB_FIFO:
+            victim = hand;
+            hand = (hand + 1) % TLB_SIZE;
+            break;
+
+        case TLB_RANDOM:
+            victim = SystemDep::Random() % TLB_SIZE;
+            break;
+
+        case TLB_CLOCK:
+            // Every entry with its `use` bit set gets a second chance.  The
+            // bit is kept in the page table, for the page replacement.
+            while (mmu->tlb[hand].use) {
+                SaveEntry(mmu->tlb[hand]);
+                mmu->tlb[hand].use = false;
+                hand = (hand + 1) % TLB_SIZE;
+            }
+            victim = hand;
+            hand = (hand + 1) % TLB_SIZE;
+            break;
+
+        case TLB_LRU:
+            for (unsigned i = 1; i < TLB_SIZE; i++) {
+                if (mmu->tlbLastUse[i] < mmu->tlbLastUse[victim]) {
+                    victim = i;
+                }
+            }
+            break;
+
+        default:
+            ASSERT(false);
+    }
+    return victim;
+}
+
+void
+TLBManager::SaveEntry(const TranslationEntry &entry) const
+{
+    ASSERT(entry.asid < NUM_ASIDS && owners[entry.asid] != nullptr);
+
+    TranslationEntry *page
+      = owners[entry.asid]->pageTable->Find(entry.virtualPage);
+    if (page != nullptr && page->valid && page->physicalPage == entry.physicalPage) {
+        page->use   = page->use   || entry.use;
+        page->dirty = page->dirty || entry.dirty;
+    }
+}
+
+void
+TLBManager::InvalidateAsid(unsigned asid)
+{
+    MMU *mmu = machine->GetMMU();
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        TranslationEntry *e = &mmu->tlb[i];
+        if (e->valid && e->asid == asid) {
+            SaveEntry(*e);
+            e->valid = false;
+        }
+    }
+    mmu->FlushHostCache();
+}
+
+void
+TLBManager::Preload(AddressSpace *space, unsigned vpn)
+{
+    if (vpn >= space->GetNumPages()) {
+        return;
+    }
+    const TranslationEntry *page = space->pageTable->Find(vpn);
+    if (page == nullptr || !page->valid) {
+        return;
+    }
+
+    MMU *mmu = machine->GetMMU();
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        const TranslationEntry *e = &mmu->tlb[i];
+        if (e->valid && e->asid == mmu->currentAsid
+              && e->virtualPage == vpn) {
+            return;
+        }
+    }
+    DEBUG('T', "Preloading virtual page %u\n", vpn);
+    mmu->tlbPreloaded[Load(*page)] = true;
+    stats->numTlbPreloads++;
+}
+
+unsigned
+TLBManager::FindAsid(const AddressSpace *space) const
+{
+    for (unsigned i = 0; i < NUM_ASIDS; i++) {
+        if (owners[i] == space) {
+            return i;
+        }
+    }
+    return NUM_ASIDS;
+}
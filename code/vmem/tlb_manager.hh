@@ -0,0 +1,152 @@
+/// Data structures to manage the contents of the TLB.
+///
+/// The TLB is loaded by the kernel, one entry at a time, whenever the
+/// translation of a page of the running address space is missing from it.
+/// When every entry is in use, one of them is replaced, chosen by one of
+/// these policies:
+///
+/// * `TLB_FIFO` -- the entry that was loaded first;
+/// * `TLB_RANDOM` -- any entry, drawn from the pseudo random generator;
+/// * `TLB_CLOCK` -- the first entry found with its `use` bit clear, giving
+///   a second chance to those that have it set (and clearing it);
+/// * `TLB_LRU` -- the entry that was used least recently, according to
+///   `MMU::tlbLastUse`.
+///
+/// Entries are tagged with the identifier (ASID) of the address space they
+/// belong to, so they survive context switches: the MMU only uses those of
+/// the running address space.  ASIDs are handed out as address spaces are
+/// run for the first time; when all `NUM_ASIDS` are taken, one is taken
+/// away from its owner, in round robin order, and the entries tagged with
+/// it are removed.  The owner gets a new one the next time it runs.
+///
+/// The `use` and `dirty` bits of an entry are copied back into the page
+/// table of its address space whenever it leaves the TLB.
+///
+/// Still, while other address spaces run, they push the entries of the
+/// ones that are waiting out of the TLB.  With warm-up enabled, the pages
+/// an address space had in the TLB when it stopped running, most recently
+/// used first, are remembered, and loaded back when it runs again, as long
+/// as they are still in memory.  Optionally, so are the pages of its
+/// program counter and stack pointer.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_TLBMANAGER__HH
+#define NACHOS_VMEM_TLBMANAGER__HH
+
+
+#include "machine/mmu.hh"
+#include "machine/translation_entry.hh"
+
+
+class AddressSpace;
+
+
+enum TLBPolicy {
+    TLB_FIFO,
+    TLB_RANDOM,
+    TLB_CLOCK,
+    TLB_LRU,
+    NUM_TLB_POLICIES
+};
+
+class TLBManager {
+public:
+
+    /// Manage the TLB of the machine, replacing entries according to
+    /// `policy`.
+    ///
+    /// * `warmUp` -- reload the translations of an address space that were
+    ///   in the TLB when it stopped running.
+    /// * `prefetch` -- also load those of the pages of its program counter
+    ///   and stack pointer.
+    TLBManager(TLBPolicy policy, bool warmUp, bool prefetch);
+
+    ~TLBManager();
+
+    /// Load `entry`, the translation of a page of the running address
+    /// space, into the TLB, replacing another one if there is no room.
+    ///
+    /// Return the index of the TLB entry it takes.
+    unsigned Load(const TranslationEntry &entry);
+
+    /// Remove the translation of virtual page `vpn` of `space` from the
+    /// TLB, if it is there.
+    void Invalidate(AddressSpace *space, unsigned vpn);
+
+    /// Copy the `use` and `dirty` bits of the translation of virtual page
+    /// `vpn` of `space` into its page table, if it is in the TLB, and clear
+    /// its `use` bit there, so that the next reference sets it again.
+    void SaveUse(AddressSpace *space, unsigned vpn);
+
+    /// Copy the `use` and `dirty` bits of the translation of virtual page
+    /// `vpn` of `space` into its page table, if it is in the TLB, and clear
+    /// its `dirty` bit there, as the page is written out while it stays in
+    /// memory.
+    void Clean(AddressSpace *space, unsigned vpn);
+
+    /// Make `space` the running address space, giving it an ASID if it
+    /// has none.
+    void SwitchTo(AddressSpace *space);
+
+    /// Remove every translation of `space` from the TLB, and free its ASID,
+    /// if it has one.
+    void Release(AddressSpace *space);
+
+    /// Remember which translations of `space`, that is about to stop
+    /// running, are in the TLB.
+    void Record(AddressSpace *space);
+
+    /// Load back the translations remembered by `Record` for `space`, that
+    /// has just been made the running address space.
+    void WarmUp(AddressSpace *space);
+
+    TLBPolicy GetPolicy() const;
+
+    /// Store in `*policy` the policy called `name` (`fifo`, `random`,
+    /// `clock` or `lru`).  Return false if there is none.
+    static bool ParsePolicy(const char *name, TLBPolicy *policy);
+
+private:
+
+    /// Choose the entry to replace.
+    unsigned PickVictim();
+
+    /// Copy the `use` and `dirty` bits of `entry` into the page table of
+    /// the address space it belongs to.
+    void SaveEntry(const TranslationEntry &entry) const;
+
+    /// Remove every entry tagged with `asid` from the TLB.
+    void InvalidateAsid(unsigned asid);
+
+    /// Return the ASID of `space`, or `NUM_ASIDS` if it has none.
+    unsigned FindAsid(const AddressSpace *space) const;
+
+    /// Load the translation of virtual page `vpn` of the running address
+    /// `space`, unless it is in the TLB already or not in memory.
+    void Preload(AddressSpace *space, unsigned vpn);
+
+    TLBPolicy policy;
+
+    /// Next entry to consider, for `TLB_FIFO` and `TLB_CLOCK`.
+    unsigned hand;
+
+    /// Address space that owns each ASID, or null if it is free.
+    AddressSpace *owners[NUM_ASIDS];
+
+    /// Next ASID to take away, when none is free.
+    unsigned asidHand;
+
+    bool warmUp;
+    bool prefetch;
+
+    /// Pages that the owner of each ASID had in the TLB when it last
+    /// stopped running, most recently used first.
+    unsigned *hotPages[NUM_ASIDS];
+    unsigned numHotPages[NUM_ASIDS];
+};
+
+
+#endif